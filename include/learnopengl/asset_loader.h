@@ -0,0 +1,303 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/cloud_impostors.h>
+#include <learnopengl/model.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Streams models and textures in the background. Model imports (mesh cache or Assimp) and image decodes
+// run on a pool of worker threads; the resulting CPU payloads are turned into GL objects on the context
+// thread by ProcessUploads, which is called once per frame with a time budget.
+// Every texture gets a 1x1 placeholder right away, so meshes can be drawn before their images arrive.
+// Textures go through the TextureRegistry, a file requested again (by any model) reuses the first texture.
+class AssetLoader
+{
+public:
+    // the number of worker threads can be overridden with LOGL_LOADER_THREADS
+    explicit AssetLoader(unsigned int threadCount = ThreadPool::DefaultThreadCount("LOGL_LOADER_THREADS"))
+        : start(std::chrono::steady_clock::now()), pool(threadCount)
+    {
+    }
+
+    // queues the import of a model file, its meshes are added to model as they are uploaded.
+    // model has to outlive the loader.
+    void LoadModel(Model &model, const std::string &path)
+    {
+        model.directory = path.substr(0, path.find_last_of('/'));
+        pending++;
+        pool.Submit([this, &model, path]() {
+            std::shared_ptr<vector<MeshData>> meshData = std::make_shared<vector<MeshData>>();
+            bool loaded = Model::LoadMeshData(path, *meshData);
+            // content hashes of the textures, so the registry can match identical files on the GL thread
+            std::shared_ptr<std::unordered_map<std::string, uint64_t>> textureHashes = std::make_shared<std::unordered_map<std::string, uint64_t>>();
+            for (const MeshData &data : *meshData)
+                for (const Texture &reference : data.textures)
+                {
+                    std::string texturePath = model.directory + '/' + reference.path;
+                    if (textureHashes->count(texturePath) == 0)
+                        (*textureHashes)[texturePath] = TextureRegistry::ContentHash(texturePath);
+                }
+            queueUpload([this, &model, path, meshData, textureHashes, loaded]() {
+                if (loaded)
+                {
+                    model.ReserveGeometry(*meshData);
+                    // one upload per mesh keeps the per-frame work bounded
+                    for (size_t i = 0; i < meshData->size(); i++)
+                    {
+                        queueUpload([this, &model, meshData, textureHashes, i]() {
+                            MeshData &data = (*meshData)[i];
+                            vector<Texture> textures = model.ResolveTextures(data.textures, [this, textureHashes](const std::string &texturePath) {
+                                return LoadTexture(texturePath, false, PLACEHOLDER_GREY, (*textureHashes)[texturePath]);
+                            });
+                            model.AddMesh(std::move(data), textures);
+                        });
+                    }
+                }
+                queueUpload([this, &model, path, loaded]() {
+                    if (!loaded)
+                    {
+                        finished();
+                        return;
+                    }
+                    model.ReportVertexMemory(path);
+                    // the texture arrays are built from the uploaded textures, the model shows placeholders until then
+                    waitFor([this, &model]() {
+                        for (const Texture &texture : model.textures_loaded)
+                            if (loadingTextures.count(texture.id) != 0)
+                                return false;
+                        return true;
+                    }, [this, &model, path]() {
+                        model.BuildMaterials(path);
+                        finished();
+                    });
+                });
+            });
+        });
+    }
+
+    // returns a texture id immediately, the image is decoded (or its compressed cache read) in the background
+    // and uploaded later. Textures already in the registry are returned as they are, with a reference added.
+    // contentHash is the file's TextureRegistry::ContentHash if the caller already has it, 0 otherwise.
+    unsigned int LoadTexture(const std::string &path, bool clampAlpha, const unsigned char placeholder[4], uint64_t contentHash = 0)
+    {
+        TextureRegistry &registry = TextureRegistry::Instance();
+        const std::string canonicalPath = TextureRegistry::CanonicalPath(path);
+        const std::string variant = clampAlpha ? "clamp" : "";
+        if (unsigned int textureID = registry.Acquire(canonicalPath, contentHash, variant))
+            return textureID;
+
+        unsigned int textureID = CreatePlaceholderTexture(placeholder);
+        registry.Register(textureID, canonicalPath, contentHash, variant);
+        loadingTextures.insert(textureID);
+        pending++;
+        pool.Submit([this, textureID, path, clampAlpha, contentHash]() {
+            uint64_t hash = contentHash != 0 ? contentHash : TextureRegistry::ContentHash(path);
+            std::shared_ptr<PreparedTexture> texture = std::make_shared<PreparedTexture>(PrepareTexture2D(path));
+            queueUpload([this, textureID, path, clampAlpha, texture, hash]() {
+                loadingTextures.erase(textureID);
+                TextureRegistry &registry = TextureRegistry::Instance();
+                // released (and deleted) while it was loading
+                if (!registry.Contains(textureID))
+                {
+                    finished();
+                    return;
+                }
+                registry.SetContentHash(textureID, hash);
+                if (texture->Valid())
+                    UploadPreparedTexture2D(textureID, *texture, path, clampAlpha);
+                else
+                    std::cout << "Texture failed to load at path: " << path << std::endl;
+                finished();
+            });
+        });
+        return textureID;
+    }
+
+    // returns a cubemap id immediately, the six faces are decoded in parallel and uploaded together
+    // order: +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
+    unsigned int LoadCubemap(const vector<std::string> &faces, const unsigned char placeholder[4])
+    {
+        struct CubemapFaces {
+            ImageData images[6];
+            std::atomic<int> remaining{6};
+        };
+        TextureRegistry &registry = TextureRegistry::Instance();
+        std::string canonicalPaths;
+        for (const std::string &face : faces)
+            canonicalPaths += TextureRegistry::CanonicalPath(face) + ';';
+        if (unsigned int textureID = registry.Acquire(canonicalPaths, 0, "cubemap"))
+            return textureID;
+
+        unsigned int textureID = CreatePlaceholderCubemap(placeholder);
+        registry.Register(textureID, canonicalPaths, 0, "cubemap");
+        // the upload waits for all six faces, with any other count it would never come and the loader never go idle
+        if (faces.size() != 6)
+        {
+            std::cout << "Cubemap needs 6 faces, got " << faces.size() << ", keeping the placeholder" << std::endl;
+            return textureID;
+        }
+        std::shared_ptr<CubemapFaces> cubemap = std::make_shared<CubemapFaces>();
+        pending++;
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            std::string path = faces[i];
+            pool.Submit([this, textureID, cubemap, path, i]() {
+                cubemap->images[i] = DecodeImage(path);
+                if (!cubemap->images[i].pixels)
+                    std::cout << "Cubemap texture failed to load at path: " << path << std::endl;
+                // the last decoded face uploads all of them
+                if (--cubemap->remaining > 0)
+                    return;
+                queueUpload([this, textureID, cubemap]() {
+                    if (!TextureRegistry::Instance().Contains(textureID))
+                    {
+                        finished();
+                        return;
+                    }
+                    bool complete = true;
+                    for (const ImageData &image : cubemap->images)
+                        complete = complete && image.pixels != nullptr;
+                    if (complete)
+                        UploadCubemap(textureID, cubemap->images);
+                    finished();
+                });
+            });
+        }
+        return textureID;
+    }
+
+    // decodes the cloud maps of directory in parallel, the last decoded one bakes the impostor atlas on its
+    // worker, and the atlas is uploaded into impostors later. impostors has to outlive the loader.
+    void LoadCloudImpostors(CloudImpostors &impostors, const std::string &directory, const glm::vec3 &lightDirection)
+    {
+        struct CloudMaps {
+            ImageData images[4];
+            std::atomic<int> remaining{4};
+        };
+        const std::vector<std::string> paths = CloudImpostors::MapPaths(directory);
+        std::shared_ptr<CloudMaps> maps = std::make_shared<CloudMaps>();
+        pending++;
+        for (unsigned int i = 0; i < paths.size(); i++)
+        {
+            std::string path = paths[i];
+            pool.Submit([this, &impostors, maps, path, i, lightDirection]() {
+                maps->images[i] = DecodeImage(path);
+                if (!maps->images[i].pixels)
+                    std::cout << "Cloud map failed to load at path: " << path << std::endl;
+                if (--maps->remaining > 0)
+                    return;
+                auto bakeStart = std::chrono::steady_clock::now();
+                std::shared_ptr<CloudImpostors::Atlas> atlas = std::make_shared<CloudImpostors::Atlas>(
+                        CloudImpostors::Bake(maps->images[0], maps->images[1], maps->images[2], maps->images[3], lightDirection));
+                double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count();
+                // the maps aren't needed anymore, only the atlas goes to the GL thread
+                for (ImageData &image : maps->images)
+                    image = ImageData();
+                queueUpload([this, &impostors, atlas, bakeMs]() {
+                    impostors.Upload(*atlas);
+                    if (impostors.Ready())
+                        std::cout << "CLOUD_IMPOSTORS:: baked " << CloudImpostors::SPRITES << " sprites into a " << impostors.Width()
+                                  << "x" << impostors.Height() << " atlas in " << bakeMs << " ms" << std::endl;
+                    finished();
+                });
+            });
+        }
+    }
+
+    // runs queued uploads on the GL thread until budgetMs is used up, at least one upload per call
+    void ProcessUploads(double budgetMs)
+    {
+        auto frameStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < waiting.size();)
+        {
+            if (!waiting[i].first())
+            {
+                i++;
+                continue;
+            }
+            std::function<void()> action = std::move(waiting[i].second);
+            waiting.erase(waiting.begin() + i);
+            action();
+        }
+        do
+        {
+            std::function<void()> upload;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (uploads.empty())
+                    return;
+                upload = std::move(uploads.front());
+                uploads.pop_front();
+            }
+            upload();
+        } while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count() < budgetMs);
+    }
+
+    // number of models and textures that haven't been fully uploaded yet
+    unsigned int Pending() const
+    {
+        return pending;
+    }
+
+    unsigned int ThreadCount() const
+    {
+        return pool.ThreadCount();
+    }
+
+    static constexpr unsigned char PLACEHOLDER_GREY[4] = {128, 128, 128, 255};
+    static constexpr unsigned char PLACEHOLDER_TRANSPARENT[4] = {0, 0, 0, 0};
+
+private:
+    std::chrono::steady_clock::time_point start;
+    std::atomic<unsigned int> pending{0};
+    std::mutex mutex;
+    std::deque<std::function<void()>> uploads;
+    // GL thread only: textures whose images haven't been uploaded yet, and actions waiting for a condition
+    std::unordered_set<unsigned int> loadingTextures;
+    std::vector<std::pair<std::function<bool()>, std::function<void()>>> waiting;
+    // declared last so the workers are joined before the queue they push into is destroyed
+    ThreadPool pool;
+
+    void queueUpload(std::function<void()> upload)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.push_back(std::move(upload));
+    }
+
+    // runs action on the GL thread in the first ProcessUploads in which ready returns true
+    void waitFor(std::function<bool()> ready, std::function<void()> action)
+    {
+        waiting.push_back(std::make_pair(std::move(ready), std::move(action)));
+    }
+
+    void finished()
+    {
+        if (--pending == 0)
+        {
+            double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "ASSET_LOADER:: all assets loaded after " << totalMs << " ms using " << pool.ThreadCount() << " worker threads" << std::endl;
+        }
+    }
+};
+
+constexpr unsigned char AssetLoader::PLACEHOLDER_GREY[4];
+constexpr unsigned char AssetLoader::PLACEHOLDER_TRANSPARENT[4];
+#endif
@@ -0,0 +1,256 @@
+#ifndef CLOUD_IMPOSTORS_H
+#define CLOUD_IMPOSTORS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Lit cloud sprites baked once from the maps in resources/objects/cloud, for camera facing billboards.
+// The maps hold four cloud puffs in 2x2 quadrants: Cloud_Alpha has their coverage, Cloud_Nor and Cloud_Nor2 two
+// normal maps of them (Cloud_Nor with flatter normals) and Cloud_Tranz their translucency, bright where they are thin.
+// Each puff is lit with both normal maps, so the atlas has a row of four sprites per normal map. A sprite is
+// cropped to its puff, so the billboards drawn with it don't cover the empty space around the cloud.
+class CloudImpostors
+{
+public:
+    static const unsigned int COLUMNS = 4;
+    static const unsigned int ROWS = 2;
+    static const unsigned int SPRITES = COLUMNS * ROWS;
+    static const int CELL_SIZE = 256;
+    // size of a whole quadrant relative to the cloud's scale, about the size of the flat cloud quads
+    static constexpr float PUFF_SCALE = 1.6f;
+
+    struct Sprite {
+        // offset and extent of the sprite in the atlas
+        glm::vec4 uvRect;
+        // world size of the billboard relative to the cloud's scale
+        glm::vec2 size;
+    };
+
+    // RGBA atlas with straight alpha, rows bottom up like the decoded images
+    struct Atlas {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;
+        Sprite sprites[SPRITES];
+        // why the atlas is empty
+        std::string error;
+    };
+
+    // file names of the maps in the cloud directory, in the order Bake takes them
+    static std::vector<std::string> MapPaths(const std::string &directory)
+    {
+        return {directory + "/Cloud_Alpha.png", directory + "/Cloud_Nor.png", directory + "/Cloud_Nor2.png",
+                directory + "/Cloud_Tranz.png"};
+    }
+
+    // runs on a worker thread (no GL calls). lightDirection points towards the light in sprite space:
+    // x right, y up, z towards the viewer. Returns an empty atlas with the reason in error if the maps don't fit
+    // together: all of the same size, the normal and translucency maps with at least three channels.
+    static Atlas Bake(const ImageData &alpha, const ImageData &normals, const ImageData &flatNormals,
+                      const ImageData &translucency, const glm::vec3 &lightDirection)
+    {
+        Atlas atlas;
+        const ImageData *maps[4] = {&alpha, &normals, &flatNormals, &translucency};
+        const char *names[4] = {"alpha", "normal", "flat normal", "translucency"};
+        const int minComponents[4] = {1, 3, 3, 3};
+        for (int i = 0; i < 4; i++)
+        {
+            const ImageData *map = maps[i];
+            if (map->pixels == nullptr || map->width != alpha.width || map->height != alpha.height || map->width < 2 ||
+                map->height < 2)
+            {
+                atlas.error = "cloud maps missing or of different sizes";
+                return atlas;
+            }
+            if (map->components < minComponents[i])
+            {
+                atlas.error = std::string("cloud ") + names[i] + " map has " + std::to_string(map->components) +
+                              " channels, needs at least " + std::to_string(minComponents[i]);
+                return atlas;
+            }
+        }
+        const glm::vec3 light = glm::normalize(lightDirection);
+        const int quadrantWidth = alpha.width / 2, quadrantHeight = alpha.height / 2;
+        atlas.width = CELL_SIZE * COLUMNS;
+        atlas.height = CELL_SIZE * ROWS;
+        atlas.pixels.assign((size_t)atlas.width * atlas.height * 4, 0);
+
+        for (unsigned int column = 0; column < COLUMNS; column++)
+        {
+            const int quadrantX = (column % 2) * quadrantWidth, quadrantY = (column / 2) * quadrantHeight;
+            // bounds of the puff in its quadrant, with a transparent border so mipmaps don't bleed into neighbours
+            int minX = quadrantWidth, minY = quadrantHeight, maxX = -1, maxY = -1;
+            for (int y = 0; y < quadrantHeight; y++)
+            {
+                for (int x = 0; x < quadrantWidth; x++)
+                {
+                    if (texel(alpha, quadrantX + x, quadrantY + y)[alpha.components - 1] <= COVERAGE_THRESHOLD)
+                        continue;
+                    minX = std::min(minX, x);
+                    maxX = std::max(maxX, x);
+                    minY = std::min(minY, y);
+                    maxY = std::max(maxY, y);
+                }
+            }
+            if (maxX < minX)
+            {
+                minX = minY = 0;
+                maxX = quadrantWidth - 1;
+                maxY = quadrantHeight - 1;
+            }
+            minX = std::max(minX - BORDER, 0);
+            minY = std::max(minY - BORDER, 0);
+            maxX = std::min(maxX + BORDER, quadrantWidth - 1);
+            maxY = std::min(maxY + BORDER, quadrantHeight - 1);
+            const int cropWidth = maxX - minX + 1, cropHeight = maxY - minY + 1;
+
+            for (unsigned int row = 0; row < ROWS; row++)
+            {
+                const ImageData &normalMap = row == 0 ? normals : flatNormals;
+                for (int y = 0; y < CELL_SIZE; y++)
+                {
+                    // source texels under this atlas texel, at least one
+                    const int y0 = minY + y * cropHeight / CELL_SIZE;
+                    const int y1 = std::max(minY + (y + 1) * cropHeight / CELL_SIZE, y0 + 1);
+                    for (int x = 0; x < CELL_SIZE; x++)
+                    {
+                        const int x0 = minX + x * cropWidth / CELL_SIZE;
+                        const int x1 = std::max(minX + (x + 1) * cropWidth / CELL_SIZE, x0 + 1);
+                        // colors weighted by coverage, so the transparent surroundings don't darken the edges
+                        glm::vec3 color(0.0f);
+                        float coverage = 0.0f;
+                        for (int sy = y0; sy < y1; sy++)
+                        {
+                            for (int sx = x0; sx < x1; sx++)
+                            {
+                                const int px = quadrantX + sx, py = quadrantY + sy;
+                                float a = texel(alpha, px, py)[alpha.components - 1] / 255.0f;
+                                color += a * shade(texel(normalMap, px, py), texel(translucency, px, py)[0] / 255.0f, light);
+                                coverage += a;
+                            }
+                        }
+                        const float count = (float)((y1 - y0) * (x1 - x0));
+                        if (coverage > 0.0f)
+                            color /= coverage;
+                        unsigned char *out = &atlas.pixels[(((size_t)(row * CELL_SIZE + y) * atlas.width) + column * CELL_SIZE + x) * 4];
+                        out[0] = toByte(color.r);
+                        out[1] = toByte(color.g);
+                        out[2] = toByte(color.b);
+                        out[3] = toByte(coverage / count);
+                    }
+                }
+                Sprite &sprite = atlas.sprites[row * COLUMNS + column];
+                sprite.uvRect = glm::vec4((float)column / COLUMNS, (float)row / ROWS, 1.0f / COLUMNS, 1.0f / ROWS);
+                sprite.size = glm::vec2((float)cropWidth / quadrantWidth, (float)cropHeight / quadrantHeight) * PUFF_SCALE;
+            }
+        }
+        return atlas;
+    }
+
+    // GL thread: creates the atlas texture
+    void Upload(const Atlas &atlas)
+    {
+        if (atlas.pixels.empty())
+        {
+            std::cout << "ERROR::CLOUD_IMPOSTORS:: " << atlas.error << ", clouds stay flat" << std::endl;
+            return;
+        }
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas.width, atlas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        std::copy(atlas.sprites, atlas.sprites + SPRITES, sprites);
+        width = atlas.width;
+        height = atlas.height;
+    }
+
+    bool Ready() const
+    {
+        return texture != 0;
+    }
+
+    unsigned int Texture() const
+    {
+        return texture;
+    }
+
+    int Width() const
+    {
+        return width;
+    }
+
+    int Height() const
+    {
+        return height;
+    }
+
+    // the sprite table of resources/shaders/cloud_impostor.vs
+    void SetUniforms(Shader &shader) const
+    {
+        glm::vec4 rects[SPRITES];
+        glm::vec2 sizes[SPRITES];
+        for (unsigned int i = 0; i < SPRITES; i++)
+        {
+            rects[i] = sprites[i].uvRect;
+            sizes[i] = sprites[i].size;
+        }
+        shader.use();
+        shader.setVec4Array("spriteRects", rects, SPRITES);
+        shader.setVec2Array("spriteSizes", sizes, SPRITES);
+    }
+
+    void Destroy()
+    {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+
+private:
+    static const unsigned char COVERAGE_THRESHOLD = 4;
+    static const int BORDER = 4;
+
+    unsigned int texture = 0;
+    int width = 0;
+    int height = 0;
+    Sprite sprites[SPRITES];
+
+    static const unsigned char *texel(const ImageData &image, int x, int y)
+    {
+        return image.pixels + ((size_t)y * image.width + x) * image.components;
+    }
+
+    static unsigned char toByte(float value)
+    {
+        return (unsigned char)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+    }
+
+    // wrapped diffuse light between a blue grey shadow and white, plus the light shining through thin parts
+    // when it comes from behind the cloud
+    static glm::vec3 shade(const unsigned char *normalTexel, float thinness, const glm::vec3 &light)
+    {
+        glm::vec3 normal = glm::vec3(normalTexel[0], normalTexel[1], normalTexel[2]) / 127.5f - glm::vec3(1.0f);
+        normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+        const float wrap = 0.5f;
+        float diffuse = std::max((glm::dot(normal, light) + wrap) / (1.0f + wrap), 0.0f);
+        const glm::vec3 shadowColor(0.55f, 0.6f, 0.7f), litColor(1.0f);
+        float transmitted = thinness * (0.35f + 0.65f * std::max(-light.z, 0.0f));
+        return glm::mix(shadowColor, litColor, diffuse) + glm::vec3(0.5f * transmitted);
+    }
+};
+
+constexpr float CloudImpostors::PUFF_SCALE;
+#endif
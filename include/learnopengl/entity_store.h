@@ -0,0 +1,135 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <glm/glm.hpp>
+
+#include <utility>
+#include <vector>
+
+// one of the single game objects: the bird, the falcon or the air balloon
+struct Actor {
+    glm::vec3 position = glm::vec3(0.0f);
+    bool alive = true;
+};
+
+// The insects as a structure of arrays, so every pass over the swarm streams through just the arrays it uses
+// (the per-frame step is InsectKernels::Step, or StepRange on parts of the swarm in parallel).
+// The alive insects are the first AliveCount() entries: an eaten insect is swapped with the last alive one and
+// the alive count shrinks, so the passes never step over eaten insects. Eaten insects keep their data behind the
+// alive ones until Revive.
+class InsectSwarm
+{
+public:
+    // model scale of the insect mesh, also the step of the motion patterns
+    static constexpr float SCALE = 0.01f;
+    // steps of the motion patterns per second, they used to take one per frame at 60 fps
+    static constexpr float PATTERN_RATE = 60.0f;
+
+    std::vector<float> positionX, positionY, positionZ;
+    // movement of the last step
+    std::vector<float> velocityX, velocityY, velocityZ;
+    // motion pattern: every 1 / PATTERN_RATE seconds x moves by SCALE * amplitude * sin(time * frequencyX) and z by
+    // SCALE * cos(time * frequencyZ)
+    std::vector<float> frequencyX, frequencyZ, amplitude;
+
+    // pattern picks one of the motion patterns of the hand placed insects, their wobbles grow with it
+    void Add(const glm::vec3 &position, unsigned int pattern)
+    {
+        positionX.push_back(position.x);
+        positionY.push_back(position.y);
+        positionZ.push_back(position.z);
+        velocityX.push_back(0.0f);
+        velocityY.push_back(0.0f);
+        velocityZ.push_back(0.0f);
+        frequencyX.push_back(1.0f / (pattern + 3));
+        frequencyZ.push_back((float)(pattern + 2));
+        amplitude.push_back((float)(pattern + 8));
+        // new insects are alive, so they go in front of the eaten ones
+        swap(Size() - 1, alive++);
+    }
+
+    void Clear()
+    {
+        for (std::vector<float> *array : arrays())
+            array->clear();
+        alive = 0;
+    }
+
+    void Reserve(size_t count)
+    {
+        for (std::vector<float> *array : arrays())
+            array->reserve(count);
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)positionX.size();
+    }
+
+    unsigned int AliveCount() const
+    {
+        return alive;
+    }
+
+    glm::vec3 Position(unsigned int i) const
+    {
+        return glm::vec3(positionX[i], positionY[i], positionZ[i]);
+    }
+
+    // eats alive insect i: the last alive insect takes its place. Returns the index the moved insect had
+    unsigned int Remove(unsigned int i)
+    {
+        swap(i, --alive);
+        return alive;
+    }
+
+    // model matrices of the alive insects, in their order in the store. alpha interpolates between the positions
+    // before the last step (0) and after it (1), the step's velocity is the difference
+    void Transforms(std::vector<glm::mat4> &transforms, float alpha = 1.0f) const
+    {
+        transforms.resize(alive);
+        Transforms(transforms.data(), 0, alive, alpha);
+    }
+
+    // the same for the alive insects begin to end only, written to transforms[begin] to transforms[end - 1], so
+    // threads can fill parts of one array
+    void Transforms(glm::mat4 *transforms, unsigned int begin, unsigned int end, float alpha) const
+    {
+        const float back = 1.0f - alpha;
+        for (unsigned int i = begin; i < end; i++)
+        {
+            glm::mat4 &model = transforms[i];
+            model = glm::mat4(SCALE);
+            model[3] = glm::vec4(positionX[i] - back * velocityX[i], positionY[i] - back * velocityY[i],
+                                 positionZ[i] - back * velocityZ[i], 1.0f);
+        }
+    }
+
+    // brings the eaten insects back where they were eaten, at rest until their next step
+    void Revive()
+    {
+        for (unsigned int i = alive; i < Size(); i++)
+            velocityX[i] = velocityY[i] = velocityZ[i] = 0.0f;
+        alive = Size();
+    }
+
+private:
+    unsigned int alive = 0;
+
+    std::vector<std::vector<float> *> arrays()
+    {
+        return {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &frequencyX, &frequencyZ, &amplitude};
+    }
+
+    void swap(unsigned int a, unsigned int b)
+    {
+        if (a == b)
+            return;
+        for (std::vector<float> *array : arrays())
+            std::swap((*array)[a], (*array)[b]);
+    }
+};
+
+constexpr float InsectSwarm::SCALE;
+constexpr float InsectSwarm::PATTERN_RATE;
+#endif
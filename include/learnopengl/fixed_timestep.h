@@ -0,0 +1,73 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Clock of a simulation advanced in steps of a fixed length, whatever the frame rate. Frame times are added to
+// an accumulator and every whole step in it is run; the remainder carries over to the next frame, and Alpha says
+// how far the frame is between the last two states, for drawing them interpolated.
+// A frame never runs more than MAX_STEPS steps, after a long stall (a breakpoint, a dragged window) the rest of
+// the time is dropped rather than catching up step by step.
+class FixedTimestep
+{
+public:
+    static const unsigned int MAX_STEPS = 8;
+
+    explicit FixedTimestep(double rate = 120.0)
+    {
+        SetRate(rate);
+    }
+
+    // steps per second
+    void SetRate(double rate)
+    {
+        step = 1.0 / rate;
+        if (accumulator > step)
+            accumulator = step;
+    }
+
+    double Rate() const
+    {
+        return 1.0 / step;
+    }
+
+    // length of a step in seconds
+    double Step() const
+    {
+        return step;
+    }
+
+    // adds the time of a frame, returns the number of steps to run for it
+    unsigned int Advance(double frameSeconds)
+    {
+        accumulator += frameSeconds;
+        unsigned int steps = 0;
+        while (accumulator >= step && steps < MAX_STEPS)
+        {
+            accumulator -= step;
+            steps++;
+        }
+        if (accumulator >= step)
+        {
+            droppedSeconds += accumulator - step;
+            accumulator = step;
+        }
+        return steps;
+    }
+
+    // 0 at the state before the last step, 1 at the state after it
+    double Alpha() const
+    {
+        return accumulator / step;
+    }
+
+    // time given up to stalls since the start
+    double DroppedSeconds() const
+    {
+        return droppedSeconds;
+    }
+
+private:
+    double step = 1.0 / 120.0;
+    double accumulator = 0.0;
+    double droppedSeconds = 0.0;
+};
+#endif
@@ -0,0 +1,100 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// std140 mirrors of the uniform blocks declared in resources/shaders. vec3 members are followed by
+// a float (or padding) so that the C++ layout matches the 16 byte alignment of std140.
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+
+struct DirLightBlock {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct LightsBlock {
+    DirLightBlock dirLight;
+    PointLightBlock pointLight;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match the std140 layout of the Camera block");
+static_assert(sizeof(LightsBlock) == 128, "LightsBlock must match the std140 layout of the Lights block");
+
+// Per-frame data shared by every program: the Camera and Lights blocks live in one uniform buffer
+// (each at an offset respecting GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) that is re-uploaded with a single
+// call per frame. Shaders pick the blocks up automatically through their binding points.
+class FrameUniforms
+{
+public:
+    // filled in by the render loop every frame before Upload
+    CameraBlock camera;
+    LightsBlock lights;
+
+    // needs the GL context
+    void Init()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+        lightsOffset = ((sizeof(CameraBlock) + alignment - 1) / alignment) * alignment;
+        staging.assign(lightsOffset + sizeof(LightsBlock), 0);
+
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_STREAM_DRAW);
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, UBO, 0, sizeof(CameraBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BLOCK_BINDING, UBO, lightsOffset, sizeof(LightsBlock));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // uploads both blocks, reallocating the storage so the driver doesn't wait for the previous frame
+    void Upload()
+    {
+        memcpy(staging.data(), &camera, sizeof(CameraBlock));
+        memcpy(staging.data() + lightsOffset, &lights, sizeof(LightsBlock));
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void Destroy()
+    {
+        glDeleteBuffers(1, &UBO);
+        UBO = 0;
+    }
+
+private:
+    unsigned int UBO = 0;
+    size_t lightsOffset = 0;
+    std::vector<unsigned char> staging;
+};
+#endif
@@ -0,0 +1,160 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// the six view frustum planes (left, right, bottom, top, near, far) of a projection * view matrix.
+// planes are normalized and point inwards: dot(plane.xyz, p) + plane.w >= 0 for points inside.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        // rows of the matrix (glm is column major)
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[3] + rows[2];
+        planes[5] = rows[3] - rows[2];
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+};
+
+// world space bounding sphere of an object space box under transform
+inline void TransformBounds(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                            glm::vec3 &center, float &radius)
+{
+    glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+    float localRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+    center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+    // the largest axis scale keeps the sphere conservative under non-uniform scaling
+    float scale = std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                           std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                    glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+    radius = localRadius * std::sqrt(scale);
+}
+
+// screen pixels covered by one object space unit of an object drawn with transform, seen from viewPosition.
+// Used to turn the object space error of a detail level into a screen space error.
+inline float ProjectedPixelsPerUnit(const glm::mat4 &transform, const glm::vec3 &viewPosition, const glm::mat4 &projection,
+                                    float viewportHeight)
+{
+    float scale = std::sqrt(std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                     std::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                              glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])))));
+    float distance = std::max(glm::length(glm::vec3(transform[3]) - viewPosition), 0.001f);
+    // projection[1][1] is 1 / tan(fovy / 2)
+    return scale * projection[1][1] * 0.5f * viewportHeight / distance;
+}
+
+// Bounding spheres of everything that may be drawn this frame, stored as separate arrays so the
+// plane tests in Cull run as straight loops over floats that the compiler can vectorize.
+class SphereCuller
+{
+public:
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<unsigned char> visible;
+    unsigned int visibleCount = 0;
+
+    void Clear()
+    {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+        visible.clear();
+        visibleCount = 0;
+    }
+
+    // adds the bounds of an object drawn with transform, returns its index for Visible
+    unsigned int Add(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 center;
+        float sphereRadius;
+        TransformBounds(transform, boundsMin, boundsMax, center, sphereRadius);
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        radius.push_back(sphereRadius);
+        visible.push_back(1);
+        return (unsigned int)radius.size() - 1;
+    }
+
+    // makes room for count more objects and returns the index of the first, their bounds are given with Set.
+    // Unlike Add, Set can be called from several threads for different objects
+    unsigned int Append(unsigned int count)
+    {
+        const unsigned int first = Count();
+        centerX.resize(first + count);
+        centerY.resize(first + count);
+        centerZ.resize(first + count);
+        radius.resize(first + count);
+        visible.resize(first + count, 1);
+        return first;
+    }
+
+    void Set(unsigned int index, const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 center;
+        TransformBounds(transform, boundsMin, boundsMax, center, radius[index]);
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        visible[index] = 1;
+    }
+
+    // tests all spheres against the frustum, a sphere is culled once it lies fully behind one plane
+    void Cull(const Frustum &frustum)
+    {
+        visibleCount = CullRange(frustum, 0, Count());
+    }
+
+    // Cull for the spheres begin to end only, returns how many of them are visible. Disjoint ranges can be
+    // culled on different threads, visibleCount is then the sum of their counts
+    unsigned int CullRange(const Frustum &frustum, unsigned int begin, unsigned int end)
+    {
+        const float *x = centerX.data();
+        const float *y = centerY.data();
+        const float *z = centerZ.data();
+        const float *r = radius.data();
+        unsigned char *inside = visible.data();
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            const float a = plane.x, b = plane.y, c = plane.z, d = plane.w;
+            for (unsigned int i = begin; i < end; i++)
+                inside[i] &= (unsigned char)(a * x[i] + b * y[i] + c * z[i] + d > -r[i]);
+        }
+        unsigned int count = 0;
+        for (unsigned int i = begin; i < end; i++)
+            count += inside[i];
+        return count;
+    }
+
+    // every sphere counts as visible when culling is disabled
+    void AcceptAll()
+    {
+        std::fill(visible.begin(), visible.end(), 1);
+        visibleCount = (unsigned int)visible.size();
+    }
+
+    bool Visible(unsigned int index) const
+    {
+        return visible[index] != 0;
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)radius.size();
+    }
+};
+#endif
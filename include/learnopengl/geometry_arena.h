@@ -0,0 +1,278 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/multi_draw.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// One vertex buffer, one index buffer and one VAO shared by all meshes of a model. Every mesh is a
+// range inside the buffers, drawn with glDrawElementsBaseVertex so its indices can stay zero based.
+// The buffers grow by doubling (the old contents are copied on the GPU), Reserve avoids that when the
+// total size is known up front. Vertices are stored in the arena's VertexLayout, and their positions a second
+// time on their own (12 bytes per vertex) for depth only passes, which then fetch nothing else.
+class GeometryArena
+{
+public:
+    unsigned int VAO = 0;
+
+    // has to be set before the first vertex is added
+    void SetLayout(const VertexLayout &vertexLayout)
+    {
+        if (vertexCount > 0)
+        {
+            std::cout << "ERROR::GEOMETRY_ARENA::LAYOUT_CHANGED_AFTER_UPLOAD" << std::endl;
+            return;
+        }
+        layout = vertexLayout;
+        // the capacity in vertices depends on the stride, the next Reserve reallocates and sets up the attributes again
+        vertexCapacity = 0;
+    }
+
+    const VertexLayout &Layout() const
+    {
+        return layout;
+    }
+
+    // makes room for at least vertexCount vertices and indexCount indices in total
+    void Reserve(size_t vertexCount, size_t indexCount)
+    {
+        if (VAO == 0)
+            create();
+        if (vertexCount > vertexCapacity)
+        {
+            size_t positionCapacity = vertexCapacity;
+            grow(positionBuffer, GL_ARRAY_BUFFER, positionCapacity, vertexCount, sizeof(glm::vec3));
+            grow(vertexBuffer, GL_ARRAY_BUFFER, vertexCapacity, vertexCount, layout.Stride());
+        }
+        if (indexCount > indexCapacity)
+            grow(indexBuffer, GL_ELEMENT_ARRAY_BUFFER, indexCapacity, indexCount, sizeof(unsigned int));
+    }
+
+    // copies the geometry of a mesh to the end of the arena, returns where it went
+    void Append(const vector<Vertex> &vertices, const vector<unsigned int> &indices, unsigned int &baseVertex, unsigned int &firstIndex)
+    {
+        Reserve(nextCapacity(vertexCapacity, vertexCount + vertices.size()), indexCapacity);
+        baseVertex = (unsigned int)vertexCount;
+
+        staging.clear();
+        layout.Pack(vertices, staging);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexCount * layout.Stride(), staging.size(), staging.data());
+        positions.clear();
+        for (const Vertex &vertex : vertices)
+            positions.push_back(vertex.Position);
+        glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), positions.size() * sizeof(glm::vec3), positions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vertexCount += vertices.size();
+
+        firstIndex = AppendIndices(indices);
+    }
+
+    // copies more indices to the end of the index buffer (e.g. detail levels of the last mesh), returns the first one
+    unsigned int AppendIndices(const vector<unsigned int> &indices)
+    {
+        Reserve(vertexCapacity, nextCapacity(indexCapacity, indexCount + indices.size()));
+        unsigned int firstIndex = (unsigned int)indexCount;
+        // the element buffer binding is VAO state
+        glBindVertexArray(VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+        glBindVertexArray(0);
+        indexCount += indices.size();
+        return firstIndex;
+    }
+
+    // sources the per-instance model matrix (locations 5 to 8, one column each) from instanceVBO
+    void SetupInstanceAttributes(unsigned int instanceVBO)
+    {
+        if (VAO == 0)
+            create();
+        glBindVertexArray(VAO);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        PointInstanceAttributes(instanceVBO, 0);
+        glBindVertexArray(0);
+    }
+
+    // makes instance 0 of the next draws read the matrix at firstInstance, expects the VAO to be bound.
+    // GL 3.3 has no base instance parameter, so ranges of one instance buffer are drawn this way.
+    void PointInstanceAttributes(unsigned int instanceVBO, unsigned int firstInstance)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int i = 0; i < 4; i++)
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void*)(firstInstance * sizeof(glm::mat4) + i * sizeof(glm::vec4)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // a second VAO over the same buffers for indirect draws: the model matrix and the material layers are
+    // per-instance attributes sourced from instanceBuffer (IndirectInstance), indexed by each command's base instance
+    unsigned int IndirectVAO(unsigned int instanceBuffer)
+    {
+        if (VAO == 0)
+            create();
+        if (indirectVAO != 0 && indirectSources[0] == vertexBuffer && indirectSources[1] == indexBuffer && indirectSources[2] == instanceBuffer)
+            return indirectVAO;
+        if (indirectVAO == 0)
+            glGenVertexArrays(1, &indirectVAO);
+        glBindVertexArray(indirectVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        setupAttributes();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribDivisor(5 + i, 1);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(IndirectInstance),
+                                  (void*)(offsetof(IndirectInstance, model) + i * sizeof(glm::vec4)));
+        }
+        glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+        glVertexAttribDivisor(MATERIAL_ATTRIBUTE, 1);
+        glVertexAttribPointer(MATERIAL_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, sizeof(IndirectInstance),
+                              (void*)offsetof(IndirectInstance, materialLayers));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        indirectSources[0] = vertexBuffer;
+        indirectSources[1] = indexBuffer;
+        indirectSources[2] = instanceBuffer;
+        return indirectVAO;
+    }
+
+    // a third VAO over the index buffer and the position stream only, for depth passes. The model matrix comes
+    // from instanceBuffer at locations 5 to 8 like in VAO, PointInstanceAttributes moves it to other instances.
+    unsigned int DepthVAO(unsigned int instanceBuffer)
+    {
+        if (VAO == 0)
+            create();
+        if (depthVAO != 0 && depthSources[0] == positionBuffer && depthSources[1] == indexBuffer && depthSources[2] == instanceBuffer)
+            return depthVAO;
+        if (depthVAO == 0)
+            glGenVertexArrays(1, &depthVAO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        PointInstanceAttributes(instanceBuffer, 0);
+        glBindVertexArray(0);
+        depthSources[0] = positionBuffer;
+        depthSources[1] = indexBuffer;
+        depthSources[2] = instanceBuffer;
+        return depthVAO;
+    }
+
+    size_t VertexCount() const
+    {
+        return vertexCount;
+    }
+
+    size_t IndexCount() const
+    {
+        return indexCount;
+    }
+
+    // bytes of vertex data in use
+    size_t VertexBytes() const
+    {
+        return vertexCount * layout.Stride();
+    }
+
+    // bytes of the position stream of depth passes
+    size_t PositionBytes() const
+    {
+        return vertexCount * sizeof(glm::vec3);
+    }
+
+private:
+    VertexLayout layout;
+    // packed vertices on their way to the GPU
+    std::vector<unsigned char> staging;
+    std::vector<glm::vec3> positions;
+    unsigned int vertexBuffer = 0;
+    unsigned int positionBuffer = 0;
+    unsigned int indexBuffer = 0;
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    // VAO for indirect draws and the vertex, index and instance buffers it was set up with
+    unsigned int indirectVAO = 0;
+    unsigned int indirectSources[3] = {0, 0, 0};
+    // VAO for depth passes and the position, index and instance buffers it was set up with
+    unsigned int depthVAO = 0;
+    unsigned int depthSources[3] = {0, 0, 0};
+
+    static size_t nextCapacity(size_t capacity, size_t required)
+    {
+        if (required <= capacity)
+            return capacity;
+        return std::max(required, capacity * 2);
+    }
+
+    void create()
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &positionBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        setupAttributes();
+        glBindVertexArray(0);
+    }
+
+    // replaces buffer with a larger one holding the same contents, the VAO is pointed at the new buffer
+    void grow(unsigned int &buffer, GLenum target, size_t &capacity, size_t newCapacity, size_t elementSize)
+    {
+        unsigned int larger;
+        glGenBuffers(1, &larger);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_STATIC_DRAW);
+        size_t used = target == GL_ARRAY_BUFFER ? vertexCount : indexCount;
+        if (used > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = larger;
+        capacity = newCapacity;
+
+        glBindVertexArray(VAO);
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+        else
+            setupAttributes();
+        glBindVertexArray(0);
+    }
+
+    // the vertex attributes of the layout, expects the VAO to be bound
+    void setupAttributes()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        // streams the layout leaves out must not be read from the buffer
+        for (unsigned int i = 1; i <= 4; i++)
+            glDisableVertexAttribArray(i);
+        layout.Setup();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,129 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <limits>
+
+// Remembers the currently bound program, vertex array, textures and constant vertex attributes so that
+// binds of the same object can be skipped. Counts every state change that actually reaches GL.
+// Code that binds state without going through the cache has to call Invalidate afterwards.
+class GLStateCache
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const unsigned int MAX_CONSTANT_ATTRIBUTES = 16;
+
+    struct Counters {
+        unsigned int programs = 0;
+        unsigned int vertexArrays = 0;
+        unsigned int textures = 0;
+        unsigned int draws = 0;
+
+        unsigned int StateChanges() const
+        {
+            return programs + vertexArrays + textures;
+        }
+    };
+
+    Counters counters;
+    // with this off every bind is issued, which gives the numbers of the old immediate mode path
+    bool skipRedundant = true;
+
+    GLStateCache()
+    {
+        Invalidate();
+    }
+
+    void Invalidate()
+    {
+        program = INVALID;
+        vertexArray = INVALID;
+        activeUnit = INVALID;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            textures[i] = INVALID;
+            textureArrays[i] = INVALID;
+        }
+        // NaN never compares equal, so the next value is always set
+        for (unsigned int i = 0; i < MAX_CONSTANT_ATTRIBUTES; i++)
+            constantAttributes[i][0] = constantAttributes[i][1] = std::numeric_limits<float>::quiet_NaN();
+    }
+
+    void ResetCounters()
+    {
+        counters = Counters();
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (skipRedundant && program == id)
+            return;
+        glUseProgram(id);
+        program = id;
+        counters.programs++;
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (skipRedundant && vertexArray == id)
+            return;
+        glBindVertexArray(id);
+        vertexArray = id;
+        counters.vertexArrays++;
+    }
+
+    void BindTexture2D(unsigned int unit, unsigned int id)
+    {
+        if (skipRedundant && unit < MAX_TEXTURE_UNITS && textures[unit] == id)
+            return;
+        ActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, id);
+        if (unit < MAX_TEXTURE_UNITS)
+            textures[unit] = id;
+        counters.textures++;
+    }
+
+    void BindTexture2DArray(unsigned int unit, unsigned int id)
+    {
+        if (skipRedundant && unit < MAX_TEXTURE_UNITS && textureArrays[unit] == id)
+            return;
+        ActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        if (unit < MAX_TEXTURE_UNITS)
+            textureArrays[unit] = id;
+        counters.textures++;
+    }
+
+    // value of a vertex attribute whose array is disabled, it stays the same for every vertex of the following draws
+    void VertexAttrib2f(unsigned int location, float x, float y)
+    {
+        if (skipRedundant && location < MAX_CONSTANT_ATTRIBUTES && constantAttributes[location][0] == x && constantAttributes[location][1] == y)
+            return;
+        glVertexAttrib2f(location, x, y);
+        if (location < MAX_CONSTANT_ATTRIBUTES)
+        {
+            constantAttributes[location][0] = x;
+            constantAttributes[location][1] = y;
+        }
+    }
+
+    void ActiveTexture(unsigned int unit)
+    {
+        if (activeUnit == unit)
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+
+private:
+    static const unsigned int INVALID = 0xFFFFFFFFu;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS];
+    unsigned int textureArrays[MAX_TEXTURE_UNITS];
+    float constantAttributes[MAX_CONSTANT_ATTRIBUTES][2];
+};
+#endif
@@ -0,0 +1,84 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Result of a GL query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) over the commands between Begin and End.
+// Results are read LATENCY frames late and only once they are available, so the query never stalls the
+// pipeline; LastResult is the most recent one that came back. Needs the GL context.
+class GpuQuery
+{
+public:
+    static const unsigned int LATENCY = 3;
+
+    explicit GpuQuery(GLenum target) : target(target)
+    {
+    }
+
+    void Init()
+    {
+        glGenQueries(LATENCY, queries);
+    }
+
+    bool Initialized() const
+    {
+        return queries[0] != 0;
+    }
+
+    void Destroy()
+    {
+        glDeleteQueries(LATENCY, queries);
+        for (unsigned int i = 0; i < LATENCY; i++)
+            queries[i] = 0;
+    }
+
+    void Begin()
+    {
+        glBeginQuery(target, queries[current]);
+    }
+
+    void End()
+    {
+        glEndQuery(target);
+        issued[current] = true;
+        current = (current + 1) % LATENCY;
+        // the oldest query, reused by the next Begin; a result that isn't there yet is dropped
+        if (issued[current])
+        {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_TRUE)
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &lastResult);
+            issued[current] = false;
+        }
+    }
+
+    uint64_t LastResult() const
+    {
+        return lastResult;
+    }
+
+private:
+    GLenum target;
+    unsigned int queries[LATENCY] = {0};
+    bool issued[LATENCY] = {false};
+    unsigned int current = 0;
+    GLuint64 lastResult = 0;
+};
+
+// how long the GPU spends on the commands between Begin and End
+class GpuTimer : public GpuQuery
+{
+public:
+    GpuTimer() : GpuQuery(GL_TIME_ELAPSED)
+    {
+    }
+
+    double LastMs() const
+    {
+        return LastResult() / 1000000.0;
+    }
+};
+#endif
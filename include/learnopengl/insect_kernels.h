@@ -0,0 +1,466 @@
+#ifndef INSECT_KERNELS_H
+#define INSECT_KERNELS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/entity_store.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LOGL_INSECT_SSE 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// AVX2 code is compiled for its own functions only and picked at run time, the rest of the build stays SSE2
+#define LOGL_INSECT_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+// what one InsectKernels::Step did
+struct InsectStepResult {
+    unsigned int captured = 0;
+    // alive insect nearest to the bird after the step, -1 if none are left
+    int nearest = -1;
+    float nearestDistance = std::numeric_limits<float>::max();
+};
+
+// The insect work of a simulation step as one pass over the InsectSwarm arrays: insects within the capture radius of the
+// bird are eaten (at the positions they had before the step, as the separate passes did), the others move along
+// their patterns and the nearest of them to the bird is found, all on squared distances. The pass runs 4 (SSE2)
+// or 8 (AVX2) insects at a time with vectorized sin and cos; the scalar kernel is the fallback and the reference.
+// The best kernel of the CPU is used unless LOGL_INSECT_SIMD says otherwise (0 or scalar, sse, avx2).
+class InsectKernels
+{
+public:
+    enum Level { SCALAR, SSE, AVX2, LEVELS };
+
+    static void Init()
+    {
+        Level best = SCALAR;
+#ifdef LOGL_INSECT_SSE
+        best = SSE;
+#endif
+#ifdef LOGL_INSECT_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            best = AVX2;
+#endif
+        supported() = best;
+        selected() = best;
+        if (const char *env = getenv("LOGL_INSECT_SIMD"))
+        {
+            if (strcmp(env, "0") == 0 || strcmp(env, "scalar") == 0)
+                selected() = SCALAR;
+            else if (strcmp(env, "sse") == 0 || strcmp(env, "avx2") == 0)
+            {
+                const Level wanted = strcmp(env, "sse") == 0 ? SSE : AVX2;
+                if (wanted > best)
+                    std::cout << "ERROR::INSECT_KERNELS:: LOGL_INSECT_SIMD=" << env << " not supported by this CPU" << std::endl;
+                selected() = std::min(wanted, best);
+            }
+            else
+                std::cout << "ERROR::INSECT_KERNELS:: unknown LOGL_INSECT_SIMD=" << env << ", use 0, scalar, sse or avx2"
+                          << std::endl;
+        }
+        std::cout << "INSECT_KERNELS:: " << Name(selected()) << " (best supported " << Name(best) << ")" << std::endl;
+    }
+
+    // the highest level the CPU runs, every level below it works too
+    static Level Supported()
+    {
+        return supported();
+    }
+
+    static Level &Selected()
+    {
+        return selected();
+    }
+
+    static const char *Name(Level level)
+    {
+        static const char *names[LEVELS] = {"scalar", "SSE2", "AVX2"};
+        return names[level];
+    }
+
+    // what StepRange found in its range of insects, Finish merges the partials of all ranges of a step
+    struct Partial {
+        // in ascending order
+        std::vector<unsigned int> captured;
+        float nearestSquared = std::numeric_limits<float>::max();
+        int nearest = -1;
+    };
+
+    // one simulation step of deltaTime seconds, ending at time, of the alive insects. Eaten insects are swapped
+    // behind the alive ones
+    static InsectStepResult Step(InsectSwarm &swarm, float time, float deltaTime, const glm::vec3 &bird, float captureRadius,
+                                 Level level)
+    {
+        Partial partial;
+        StepRange(swarm, 0, swarm.AliveCount(), time, deltaTime, bird, captureRadius, level, partial);
+        return Finish(swarm, &partial, 1);
+    }
+
+    // the pass of Step over the alive insects begin to end only, without eating the captured ones yet, so that
+    // disjoint ranges can run on different threads. With ranges starting at multiples of 8 the insects go through
+    // the same kernel code as in one pass over all of them
+    static void StepRange(InsectSwarm &swarm, unsigned int begin, unsigned int end, float time, float deltaTime,
+                          const glm::vec3 &bird, float captureRadius, Level level, Partial &partial)
+    {
+        Pass pass(swarm, begin, end, time, InsectSwarm::SCALE * InsectSwarm::PATTERN_RATE * deltaTime, bird,
+                  captureRadius * captureRadius, partial);
+        run<true>(pass, level);
+    }
+
+    // only the motion of StepRange: no insect is eaten and none is looked for, for when the spatial hash answers
+    // those queries
+    static void MoveRange(InsectSwarm &swarm, unsigned int begin, unsigned int end, float time, float deltaTime, Level level)
+    {
+        Partial unused;
+        Pass pass(swarm, begin, end, time, InsectSwarm::SCALE * InsectSwarm::PATTERN_RATE * deltaTime, glm::vec3(0.0f),
+                  0.0f, unused);
+        run<false>(pass, level);
+    }
+
+    // ends a step run as StepRange over consecutive ranges, partials in the order of their ranges: the nearest
+    // insect of all is found and the captured ones are eaten
+    static InsectStepResult Finish(InsectSwarm &swarm, const Partial *partials, unsigned int count)
+    {
+        InsectStepResult result;
+        float nearestSquared = std::numeric_limits<float>::max();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            result.captured += (unsigned int)partials[i].captured.size();
+            // on equal distances the earlier range, it has the lower index
+            if (partials[i].nearest >= 0 && (result.nearest < 0 || partials[i].nearestSquared < nearestSquared))
+            {
+                nearestSquared = partials[i].nearestSquared;
+                result.nearest = partials[i].nearest;
+            }
+        }
+        // the captured insects go behind the alive ones, the highest index first so every swap brings in an alive insect
+        for (unsigned int i = count; i-- > 0;)
+        {
+            const std::vector<unsigned int> &captured = partials[i].captured;
+            for (size_t j = captured.size(); j-- > 0;)
+            {
+                unsigned int moved = swarm.Remove(captured[j]);
+                if (result.nearest == (int)moved)
+                    result.nearest = (int)captured[j];
+            }
+        }
+        if (result.nearest >= 0)
+            result.nearestDistance = std::sqrt(nearestSquared);
+        return result;
+    }
+
+private:
+    static Level &supported()
+    {
+        static Level level = SCALAR;
+        return level;
+    }
+
+    static Level &selected()
+    {
+        static Level level = SCALAR;
+        return level;
+    }
+
+    // arrays and parameters of one StepRange, and what the kernels found
+    struct Pass {
+        float *positionX, *positionY, *positionZ;
+        float *velocityX, *velocityY, *velocityZ;
+        const float *frequencyX, *frequencyZ, *amplitude;
+        unsigned int begin, end;
+        float time;
+        // SCALE for a step of a pattern, scaled to the length of this step
+        float scale;
+        glm::vec3 bird;
+        float radiusSquared;
+        Partial &found;
+
+        Pass(InsectSwarm &swarm, unsigned int begin, unsigned int end, float time, float scale, const glm::vec3 &bird,
+             float radiusSquared, Partial &found)
+            : positionX(swarm.positionX.data()), positionY(swarm.positionY.data()), positionZ(swarm.positionZ.data()),
+              velocityX(swarm.velocityX.data()), velocityY(swarm.velocityY.data()), velocityZ(swarm.velocityZ.data()),
+              frequencyX(swarm.frequencyX.data()), frequencyZ(swarm.frequencyZ.data()), amplitude(swarm.amplitude.data()),
+              begin(begin), end(end), time(time), scale(scale), bird(bird), radiusSquared(radiusSquared), found(found)
+        {
+        }
+    };
+
+    // the kernels of the level on the pass's range. With track false they only move the insects
+    template <bool track>
+    static void run(Pass &pass, Level level)
+    {
+        unsigned int begin = pass.begin;
+#ifdef LOGL_INSECT_AVX2
+        if (level == AVX2)
+            begin = stepAVX2<track>(pass);
+#endif
+#ifdef LOGL_INSECT_SSE
+        if (level == SSE)
+            begin = stepSSE<track>(pass);
+#endif
+        // the scalar kernel, also for the insects left over after the last full vector
+        stepScalar<track>(pass, begin);
+    }
+
+    template <bool track>
+    static void stepScalar(Pass &pass, unsigned int begin)
+    {
+        for (unsigned int i = begin; i < pass.end; i++)
+        {
+            if (track)
+            {
+                float dx = pass.positionX[i] - pass.bird.x, dy = pass.positionY[i] - pass.bird.y, dz = pass.positionZ[i] - pass.bird.z;
+                if (dx * dx + dy * dy + dz * dz < pass.radiusSquared)
+                {
+                    // a captured insect stays where it was caught, standing still like in the vector kernels
+                    pass.found.captured.push_back(i);
+                    pass.velocityX[i] = pass.velocityY[i] = pass.velocityZ[i] = 0.0f;
+                    continue;
+                }
+            }
+            pass.velocityX[i] = pass.scale * pass.amplitude[i] * std::sin(pass.time * pass.frequencyX[i]);
+            pass.velocityZ[i] = pass.scale * std::cos(pass.time * pass.frequencyZ[i]);
+            pass.positionX[i] += pass.velocityX[i];
+            pass.positionY[i] += pass.velocityY[i];
+            pass.positionZ[i] += pass.velocityZ[i];
+            if (!track)
+                continue;
+            float dx = pass.positionX[i] - pass.bird.x;
+            float dy = pass.positionY[i] - pass.bird.y;
+            float dz = pass.positionZ[i] - pass.bird.z;
+            float squared = dx * dx + dy * dy + dz * dz;
+            if (squared < pass.found.nearestSquared)
+            {
+                pass.found.nearestSquared = squared;
+                pass.found.nearest = (int)i;
+            }
+        }
+    }
+
+    // constants of the vectorized sin and cos: the argument is reduced by multiples of pi/2 in three parts
+    // (Cody-Waite) and the remainder in [-pi/4, pi/4] goes through the minimax polynomials of the Cephes sinf/cosf
+    static constexpr float TWO_OVER_PI = 0.636619772367581f;
+    static constexpr float PI_OVER_2_HIGH = 1.5703125f;
+    static constexpr float PI_OVER_2_MIDDLE = 4.837512969970703125e-4f;
+    static constexpr float PI_OVER_2_LOW = 7.54978995489188216e-8f;
+    static constexpr float SIN_1 = -1.6666654611e-1f, SIN_2 = 8.3321608736e-3f, SIN_3 = -1.9515295891e-4f;
+    static constexpr float COS_1 = 4.166664568298827e-2f, COS_2 = -1.388731625493765e-3f, COS_3 = 2.443315711809948e-5f;
+
+#ifdef LOGL_INSECT_SSE
+    // sin(x) if phase is 0, cos(x) if it is 1
+    static __m128 sinSSE(__m128 x, int phase)
+    {
+        __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+        __m128 q = _mm_cvtepi32_ps(quadrant);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_HIGH)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_MIDDLE)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_LOW)));
+        __m128 r2 = _mm_mul_ps(r, r);
+        __m128 sinR = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_3), r2), _mm_set1_ps(SIN_2));
+        sinR = _mm_add_ps(_mm_mul_ps(sinR, r2), _mm_set1_ps(SIN_1));
+        sinR = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinR, r2), r), r);
+        __m128 cosR = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_3), r2), _mm_set1_ps(COS_2));
+        cosR = _mm_add_ps(_mm_mul_ps(cosR, r2), _mm_set1_ps(COS_1));
+        cosR = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(cosR, r2), r2), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+        // quadrants 1 and 3 take the cosine of the remainder, 2 and 3 flip the sign
+        quadrant = _mm_add_epi32(quadrant, _mm_set1_epi32(phase));
+        __m128 useCos = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+        __m128 result = _mm_or_ps(_mm_and_ps(useCos, cosR), _mm_andnot_ps(useCos, sinR));
+        __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+        return _mm_xor_ps(result, sign);
+    }
+
+    // returns where the scalar kernel takes over
+    template <bool track>
+    static unsigned int stepSSE(Pass &pass)
+    {
+        const __m128 birdX = _mm_set1_ps(pass.bird.x), birdY = _mm_set1_ps(pass.bird.y), birdZ = _mm_set1_ps(pass.bird.z);
+        const __m128 radiusSquared = _mm_set1_ps(pass.radiusSquared), time = _mm_set1_ps(pass.time);
+        const __m128 scale = _mm_set1_ps(pass.scale), infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        // nearest per lane, indices kept in the float lanes bit for bit
+        __m128 nearestSquared = infinity;
+        __m128i nearest = _mm_set1_epi32(-1);
+        __m128i index = _mm_add_epi32(_mm_set1_epi32((int)pass.begin), _mm_setr_epi32(0, 1, 2, 3));
+        const unsigned int end = pass.begin + ((pass.end - pass.begin) & ~3u);
+        for (unsigned int i = pass.begin; i < end; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(pass.positionX + i), y = _mm_loadu_ps(pass.positionY + i), z = _mm_loadu_ps(pass.positionZ + i);
+            __m128 captured = _mm_setzero_ps();
+            if (track)
+            {
+                __m128 dx = _mm_sub_ps(x, birdX), dy = _mm_sub_ps(y, birdY), dz = _mm_sub_ps(z, birdZ);
+                __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                captured = _mm_cmplt_ps(squared, radiusSquared);
+                if (int mask = _mm_movemask_ps(captured))
+                    for (unsigned int lane = 0; lane < 4; lane++)
+                        if (mask & (1 << lane))
+                            pass.found.captured.push_back(i + lane);
+            }
+
+            __m128 vx = _mm_mul_ps(_mm_mul_ps(scale, _mm_loadu_ps(pass.amplitude + i)),
+                                   sinSSE(_mm_mul_ps(time, _mm_loadu_ps(pass.frequencyX + i)), 0));
+            __m128 vy = _mm_loadu_ps(pass.velocityY + i);
+            __m128 vz = _mm_mul_ps(scale, sinSSE(_mm_mul_ps(time, _mm_loadu_ps(pass.frequencyZ + i)), 1));
+            // eaten insects stay where they are
+            vx = _mm_andnot_ps(captured, vx);
+            vy = _mm_andnot_ps(captured, vy);
+            vz = _mm_andnot_ps(captured, vz);
+            x = _mm_add_ps(x, vx);
+            y = _mm_add_ps(y, vy);
+            z = _mm_add_ps(z, vz);
+            _mm_storeu_ps(pass.velocityX + i, vx);
+            _mm_storeu_ps(pass.velocityZ + i, vz);
+            _mm_storeu_ps(pass.positionX + i, x);
+            _mm_storeu_ps(pass.positionY + i, y);
+            _mm_storeu_ps(pass.positionZ + i, z);
+            if (!track)
+                continue;
+
+            __m128 dx = _mm_sub_ps(x, birdX), dy = _mm_sub_ps(y, birdY), dz = _mm_sub_ps(z, birdZ);
+            __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            squared = _mm_or_ps(_mm_and_ps(captured, infinity), _mm_andnot_ps(captured, squared));
+            __m128 nearer = _mm_cmplt_ps(squared, nearestSquared);
+            nearestSquared = _mm_or_ps(_mm_and_ps(nearer, squared), _mm_andnot_ps(nearer, nearestSquared));
+            __m128i nearerInt = _mm_castps_si128(nearer);
+            nearest = _mm_or_si128(_mm_and_si128(nearerInt, index), _mm_andnot_si128(nearerInt, nearest));
+            index = _mm_add_epi32(index, _mm_set1_epi32(4));
+        }
+        if (track)
+        {
+            float laneSquared[4];
+            int laneNearest[4];
+            _mm_storeu_ps(laneSquared, nearestSquared);
+            _mm_storeu_si128((__m128i *)laneNearest, nearest);
+            reduce(pass, laneSquared, laneNearest, 4);
+        }
+        return end;
+    }
+#endif
+
+#ifdef LOGL_INSECT_AVX2
+    __attribute__((target("avx2,fma")))
+    static __m256 sinAVX2(__m256 x, int phase)
+    {
+        __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+        __m256 q = _mm256_cvtepi32_ps(quadrant);
+        __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_HIGH), x);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_MIDDLE), r);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_LOW), r);
+        __m256 r2 = _mm256_mul_ps(r, r);
+        __m256 sinR = _mm256_fmadd_ps(_mm256_set1_ps(SIN_3), r2, _mm256_set1_ps(SIN_2));
+        sinR = _mm256_fmadd_ps(sinR, r2, _mm256_set1_ps(SIN_1));
+        sinR = _mm256_fmadd_ps(_mm256_mul_ps(sinR, r2), r, r);
+        __m256 cosR = _mm256_fmadd_ps(_mm256_set1_ps(COS_3), r2, _mm256_set1_ps(COS_2));
+        cosR = _mm256_fmadd_ps(cosR, r2, _mm256_set1_ps(COS_1));
+        cosR = _mm256_fmadd_ps(_mm256_mul_ps(cosR, r2), r2, _mm256_fnmadd_ps(r2, _mm256_set1_ps(0.5f), _mm256_set1_ps(1.0f)));
+        quadrant = _mm256_add_epi32(quadrant, _mm256_set1_epi32(phase));
+        __m256 useCos = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+        __m256 result = _mm256_blendv_ps(sinR, cosR, useCos);
+        __m256 sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+        return _mm256_xor_ps(result, sign);
+    }
+
+    template <bool track>
+    __attribute__((target("avx2,fma")))
+    static unsigned int stepAVX2(Pass &pass)
+    {
+        const __m256 birdX = _mm256_set1_ps(pass.bird.x), birdY = _mm256_set1_ps(pass.bird.y), birdZ = _mm256_set1_ps(pass.bird.z);
+        const __m256 radiusSquared = _mm256_set1_ps(pass.radiusSquared), time = _mm256_set1_ps(pass.time);
+        const __m256 scale = _mm256_set1_ps(pass.scale), infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        __m256 nearestSquared = infinity;
+        __m256i nearest = _mm256_set1_epi32(-1);
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)pass.begin), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        const unsigned int end = pass.begin + ((pass.end - pass.begin) & ~7u);
+        for (unsigned int i = pass.begin; i < end; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(pass.positionX + i), y = _mm256_loadu_ps(pass.positionY + i), z = _mm256_loadu_ps(pass.positionZ + i);
+            __m256 captured = _mm256_setzero_ps();
+            if (track)
+            {
+                __m256 dx = _mm256_sub_ps(x, birdX), dy = _mm256_sub_ps(y, birdY), dz = _mm256_sub_ps(z, birdZ);
+                __m256 squared = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+                captured = _mm256_cmp_ps(squared, radiusSquared, _CMP_LT_OQ);
+                if (int mask = _mm256_movemask_ps(captured))
+                    for (unsigned int lane = 0; lane < 8; lane++)
+                        if (mask & (1 << lane))
+                            pass.found.captured.push_back(i + lane);
+            }
+
+            __m256 vx = _mm256_mul_ps(_mm256_mul_ps(scale, _mm256_loadu_ps(pass.amplitude + i)),
+                                      sinAVX2(_mm256_mul_ps(time, _mm256_loadu_ps(pass.frequencyX + i)), 0));
+            __m256 vy = _mm256_loadu_ps(pass.velocityY + i);
+            __m256 vz = _mm256_mul_ps(scale, sinAVX2(_mm256_mul_ps(time, _mm256_loadu_ps(pass.frequencyZ + i)), 1));
+            vx = _mm256_andnot_ps(captured, vx);
+            vy = _mm256_andnot_ps(captured, vy);
+            vz = _mm256_andnot_ps(captured, vz);
+            x = _mm256_add_ps(x, vx);
+            y = _mm256_add_ps(y, vy);
+            z = _mm256_add_ps(z, vz);
+            _mm256_storeu_ps(pass.velocityX + i, vx);
+            _mm256_storeu_ps(pass.velocityZ + i, vz);
+            _mm256_storeu_ps(pass.positionX + i, x);
+            _mm256_storeu_ps(pass.positionY + i, y);
+            _mm256_storeu_ps(pass.positionZ + i, z);
+            if (!track)
+                continue;
+
+            __m256 dx = _mm256_sub_ps(x, birdX), dy = _mm256_sub_ps(y, birdY), dz = _mm256_sub_ps(z, birdZ);
+            __m256 squared = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+            squared = _mm256_blendv_ps(squared, infinity, captured);
+            __m256 nearer = _mm256_cmp_ps(squared, nearestSquared, _CMP_LT_OQ);
+            nearestSquared = _mm256_blendv_ps(nearestSquared, squared, nearer);
+            nearest = _mm256_blendv_epi8(nearest, index, _mm256_castps_si256(nearer));
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+        }
+        if (track)
+        {
+            float laneSquared[8];
+            int laneNearest[8];
+            _mm256_storeu_ps(laneSquared, nearestSquared);
+            _mm256_storeu_si256((__m256i *)laneNearest, nearest);
+            reduce(pass, laneSquared, laneNearest, 8);
+        }
+        return end;
+    }
+#endif
+
+    // nearest of the lanes, on equal distances the lowest index like the scalar kernel
+    static void reduce(Pass &pass, const float *laneSquared, const int *laneNearest, unsigned int lanes)
+    {
+        for (unsigned int lane = 0; lane < lanes; lane++)
+        {
+            if (laneNearest[lane] < 0)
+                continue;
+            Partial &found = pass.found;
+            if (laneSquared[lane] < found.nearestSquared ||
+                (laneSquared[lane] == found.nearestSquared && laneNearest[lane] < found.nearest))
+            {
+                found.nearestSquared = laneSquared[lane];
+                found.nearest = laneNearest[lane];
+            }
+        }
+    }
+};
+
+constexpr float InsectKernels::TWO_OVER_PI;
+constexpr float InsectKernels::PI_OVER_2_HIGH;
+constexpr float InsectKernels::PI_OVER_2_MIDDLE;
+constexpr float InsectKernels::PI_OVER_2_LOW;
+constexpr float InsectKernels::SIN_1;
+constexpr float InsectKernels::SIN_2;
+constexpr float InsectKernels::SIN_3;
+constexpr float InsectKernels::COS_1;
+constexpr float InsectKernels::COS_2;
+constexpr float InsectKernels::COS_3;
+#endif
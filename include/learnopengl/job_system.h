@@ -0,0 +1,335 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// jobs of a batch that haven't finished yet, JobSystem::Wait returns once it is done
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool Done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{0};
+};
+
+// Work-stealing job scheduler for the work of a frame. Every thread has its own queue: a thread pushes the
+// jobs it submits at the back of its queue and takes its next job from there too, so a job's children run while
+// their data is still in its cache; an idle thread steals the oldest job from the front of another queue, the
+// biggest piece of work left. The thread that creates the system is thread 0 and runs jobs while it waits
+// (so does any thread in Wait, but only the jobs it waits for), the others are workers that sleep when there is
+// nothing to do.
+// Unlike ThreadPool, which runs long independent tasks like file loading, jobs are short and wait on each other.
+class JobSystem
+{
+public:
+    // workers spin this many rounds for new jobs before going to sleep, jobs of the same frame come in bursts
+    static const unsigned int SPIN_BEFORE_SLEEP = 256;
+
+    explicit JobSystem(unsigned int threadCount)
+    {
+        threadCount = std::max(threadCount, 1u);
+        for (unsigned int i = 0; i < threadCount; i++)
+            queues.emplace_back(new Queue());
+        active = threadCount;
+        threadIndex() = 0;
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // jobs still queued are dropped, wait for them first
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    // threads including the calling one
+    unsigned int ThreadCount() const
+    {
+        return (unsigned int)queues.size();
+    }
+
+    // lets only the first count threads run jobs, the others sleep; for measuring how the work scales
+    void SetActiveThreads(unsigned int count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            active = std::min(std::max(count, 1u), ThreadCount());
+        }
+        wakeUp.notify_all();
+    }
+
+    unsigned int ActiveThreads() const
+    {
+        return active.load();
+    }
+
+    // queues job, counter is done once it and all other jobs submitted with it have run. Jobs may submit jobs
+    void Submit(std::function<void()> job, JobCounter &counter)
+    {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        Queue &queue = *queues[currentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(Job{std::move(job), &counter});
+        }
+        queued.fetch_add(1);
+        if (sleeping.load() > 0)
+        {
+            // taking the mutex makes sure a worker deciding to sleep either sees the job or gets the notification
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            if (active.load() < ThreadCount())
+                wakeUp.notify_all();
+            else
+                wakeUp.notify_one();
+        }
+    }
+
+    // runs queued jobs of counter until it is done. Other jobs are left to the workers, so a short wait (the main
+    // thread waiting for its culling) doesn't pick up a long job submitted before it (the frame's simulation)
+    void Wait(JobCounter &counter)
+    {
+        const unsigned int index = currentQueue();
+        // a job waiting here isn't working: the jobs it runs meanwhile count for themselves, the rest is idle
+        const uint64_t excludedBefore = excludedNanoseconds();
+        auto start = std::chrono::steady_clock::now();
+        while (!counter.Done())
+        {
+            if (!runOne(index, &counter))
+                std::this_thread::yield();
+        }
+        excludedNanoseconds() = excludedBefore + nanosecondsSince(start);
+    }
+
+    // calls body(chunkBegin, chunkEnd) for chunks of at most grain indices covering begin to end, in parallel,
+    // and returns when all are done. A range of one chunk runs right here
+    template <typename Body>
+    void ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, const Body &body)
+    {
+        if (end <= begin)
+            return;
+        grain = std::max(grain, 1u);
+        if (end - begin <= grain)
+        {
+            body(begin, end);
+            return;
+        }
+        JobCounter counter;
+        for (unsigned int chunk = begin; chunk < end; chunk += std::min(grain, end - chunk))
+        {
+            const unsigned int chunkEnd = chunk + std::min(grain, end - chunk);
+            Submit([&body, chunk, chunkEnd]() { body(chunk, chunkEnd); }, counter);
+        }
+        Wait(counter);
+    }
+
+    // milliseconds every thread spent working in jobs since the last call, the counters start over. A job's time
+    // in Wait is left out, the jobs it runs there are counted once, as themselves
+    void TakeBusyMs(std::vector<double> &busyMs)
+    {
+        busyMs.resize(queues.size());
+        for (size_t i = 0; i < queues.size(); i++)
+            busyMs[i] = queues[i]->busyNanoseconds.exchange(0) / 1000000.0;
+    }
+
+private:
+    struct Job {
+        std::function<void()> run;
+        JobCounter *counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::atomic<uint64_t> busyNanoseconds{0};
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // jobs in all queues
+    std::atomic<unsigned int> queued{0};
+    std::atomic<unsigned int> active{1};
+    std::atomic<unsigned int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    // index of the calling thread in the system, -1 for threads that are not part of it
+    static int &threadIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    // time within the job running on this thread that isn't its own work: its nested jobs and waits
+    static uint64_t &excludedNanoseconds()
+    {
+        static thread_local uint64_t nanoseconds = 0;
+        return nanoseconds;
+    }
+
+    static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // threads that are not part of the system share the queue of thread 0
+    unsigned int currentQueue() const
+    {
+        return threadIndex() >= 0 && (unsigned int)threadIndex() < queues.size() ? (unsigned int)threadIndex() : 0u;
+    }
+
+    // the newest job of the own queue or else the oldest of another, only jobs of counter unless it is null.
+    // False if there are none
+    bool runOne(unsigned int index, const JobCounter *counter = nullptr)
+    {
+        if (queued.load() == 0)
+            return false;
+        Job job;
+        bool found = pop(*queues[index], job, false, counter);
+        for (size_t i = 1; !found && i < queues.size(); i++)
+            found = pop(*queues[(index + i) % queues.size()], job, true, counter);
+        if (!found)
+            return false;
+        queued.fetch_sub(1);
+
+        // jobs run inside jobs through Wait, each counts only its own work and is left out of the enclosing one
+        const uint64_t excludedOutside = excludedNanoseconds();
+        excludedNanoseconds() = 0;
+        auto start = std::chrono::steady_clock::now();
+        job.run();
+        // the job's captures go before the counter says it is done, the waiting thread may free what they point to
+        job.run = nullptr;
+        const uint64_t elapsed = nanosecondsSince(start);
+        queues[index]->busyNanoseconds.fetch_add(elapsed - std::min(excludedNanoseconds(), elapsed));
+        excludedNanoseconds() = excludedOutside + elapsed;
+        job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    // a queue holds the chunks of a few batches at most, so finding the jobs of a counter in it is a short scan
+    static bool pop(Queue &queue, Job &job, bool steal, const JobCounter *counter)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        const size_t size = queue.jobs.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const size_t position = steal ? i : size - 1 - i;
+            if (counter != nullptr && queue.jobs[position].counter != counter)
+                continue;
+            job = std::move(queue.jobs[position]);
+            queue.jobs.erase(queue.jobs.begin() + position);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        threadIndex() = (int)index;
+        unsigned int idle = 0;
+        while (true)
+        {
+            if (index < active.load() && runOne(index))
+            {
+                idle = 0;
+                continue;
+            }
+            if (++idle < SPIN_BEFORE_SLEEP)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            idle = 0;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            wakeUp.wait(lock, [this, index]() { return stopping || (index < active.load() && queued.load() > 0); });
+            sleeping.fetch_sub(1);
+            if (stopping)
+                return;
+        }
+    }
+};
+
+// Jobs with dependencies between them: a job is submitted once all jobs it depends on have finished. The graph
+// is built once and can be run again after the counter of its last run is done.
+class JobGraph
+{
+public:
+    // returns the id of the job for Depend
+    unsigned int Add(std::function<void()> job)
+    {
+        nodes.emplace_back(std::move(job));
+        return (unsigned int)nodes.size() - 1;
+    }
+
+    // job runs only after before has finished
+    void Depend(unsigned int job, unsigned int before)
+    {
+        nodes[before].successors.push_back(job);
+        nodes[job].dependencies++;
+    }
+
+    // starts the jobs without dependencies and returns, counter is done when every job of the graph has run
+    void Run(JobSystem &jobs, JobCounter &counter)
+    {
+        for (Node &node : nodes)
+            node.remaining.store(node.dependencies);
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            if (nodes[i].dependencies == 0)
+                submit(jobs, i, counter);
+    }
+
+private:
+    struct Node {
+        std::function<void()> job;
+        std::vector<unsigned int> successors;
+        int dependencies = 0;
+        std::atomic<int> remaining{0};
+
+        explicit Node(std::function<void()> job) : job(std::move(job))
+        {
+        }
+    };
+    // a deque, the nodes hold atomics and can't move
+    std::deque<Node> nodes;
+
+    void submit(JobSystem &jobs, unsigned int i, JobCounter &counter)
+    {
+        jobs.Submit([this, &jobs, i, &counter]() {
+            nodes[i].job();
+            // successors are submitted before this job counts as done, so the counter can't run empty in between
+            for (unsigned int successor : nodes[i].successors)
+                if (nodes[successor].remaining.fetch_sub(1) == 1)
+                    submit(jobs, successor, counter);
+        }, counter);
+    }
+};
+#endif
@@ -0,0 +1,193 @@
+#ifndef MATERIAL_ARRAYS_H
+#define MATERIAL_ARRAYS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// The textures of a model copied into GL_TEXTURE_2D_ARRAYs, one array per size and format, so meshes
+// with different materials can be drawn without binding textures in between: a mesh only selects its
+// layers (see MeshMaterial). Textures are read back from their 2D texture objects, compressed ones stay
+// compressed, so this works for whatever the loader uploaded. Needs the GL context.
+class MaterialArrays
+{
+public:
+    // layers of the placeholder array: grey like AssetLoader::PLACEHOLDER_GREY, and black for meshes without a specular map
+    static const unsigned int PLACEHOLDER_DIFFUSE = 0;
+    static const unsigned int PLACEHOLDER_NO_SPECULAR = 1;
+
+    // 1x1 array shared by all meshes until their model's arrays have been built
+    static unsigned int PlaceholderArray()
+    {
+        static unsigned int array = 0;
+        if (array != 0)
+            return array;
+        const unsigned char pixels[2][4] = {{128, 128, 128, 255}, {0, 0, 0, 255}};
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return array;
+    }
+
+    static MeshMaterial PlaceholderMaterial()
+    {
+        MeshMaterial material;
+        material.diffuse = {PlaceholderArray(), PLACEHOLDER_DIFFUSE};
+        material.specular = {PlaceholderArray(), PLACEHOLDER_NO_SPECULAR};
+        return material;
+    }
+
+    // copies the 2D textures into arrays, replacing arrays built before. Textures with the same size, format
+    // and number of mip levels share an array.
+    void Build(const std::vector<unsigned int> &textureIDs)
+    {
+        Destroy();
+        std::map<std::tuple<GLint, GLint, GLint, GLint>, std::vector<unsigned int>> groups;
+        std::unordered_map<unsigned int, Source> sources;
+        for (unsigned int textureID : textureIDs)
+        {
+            if (sources.count(textureID) != 0)
+                continue;
+            Source source = describe(textureID);
+            sources[textureID] = source;
+            // a texture that failed to load has no image, its meshes keep the placeholder
+            if (source.width <= 0 || source.height <= 0)
+                continue;
+            groups[std::make_tuple(source.format, source.width, source.height, source.levels)].push_back(textureID);
+        }
+
+        std::vector<unsigned char> buffer;
+        for (const auto &group : groups)
+        {
+            const Source &first = sources[group.second[0]];
+            unsigned int array;
+            glGenTextures(1, &array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            GLsizei layers = (GLsizei)group.second.size();
+            for (GLint level = 0; level < first.levels; level++)
+            {
+                GLsizei width = std::max(first.width >> level, 1), height = std::max(first.height >> level, 1);
+                if (first.compressed)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, first.format, width, height, layers, 0,
+                                           first.levelSizes[level] * layers, nullptr);
+                else
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                vramBytes += (size_t)first.levelSizes[level] * layers;
+
+                for (GLsizei layer = 0; layer < layers; layer++)
+                {
+                    unsigned int textureID = group.second[layer];
+                    glBindTexture(GL_TEXTURE_2D, textureID);
+                    buffer.resize(first.levelSizes[level]);
+                    if (first.compressed)
+                    {
+                        glGetCompressedTexImage(GL_TEXTURE_2D, level, buffer.data());
+                        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, first.format,
+                                                  first.levelSizes[level], buffer.data());
+                    }
+                    else
+                    {
+                        glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+                    }
+                    layerOf[textureID] = {array, (unsigned int)layer};
+                }
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, first.levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, first.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            arrays.push_back(array);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // the array layer a texture was copied to, the placeholder layer if it wasn't part of Build
+    MaterialLayer LayerOf(unsigned int textureID, unsigned int placeholderLayer) const
+    {
+        auto layer = layerOf.find(textureID);
+        if (layer == layerOf.end())
+            return {PlaceholderArray(), placeholderLayer};
+        return layer->second;
+    }
+
+    unsigned int ArrayCount() const
+    {
+        return (unsigned int)arrays.size();
+    }
+
+    size_t VramBytes() const
+    {
+        return vramBytes;
+    }
+
+    void Destroy()
+    {
+        if (!arrays.empty())
+            glDeleteTextures((GLsizei)arrays.size(), arrays.data());
+        arrays.clear();
+        layerOf.clear();
+        vramBytes = 0;
+    }
+
+private:
+    // size and format of a 2D texture, and the bytes of each of its mip levels as they are read back
+    struct Source {
+        GLint width = 1;
+        GLint height = 1;
+        GLint format = GL_RGBA8;
+        GLint levels = 1;
+        bool compressed = false;
+        std::vector<GLint> levelSizes;
+    };
+
+    std::vector<unsigned int> arrays;
+    std::unordered_map<unsigned int, MaterialLayer> layerOf;
+    size_t vramBytes = 0;
+
+    static Source describe(unsigned int textureID)
+    {
+        Source source;
+        GLint compressed = GL_FALSE, maxLevel = 0;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &source.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &source.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        source.compressed = compressed == GL_TRUE;
+        // uncompressed textures are stored as RGBA8 whatever their channels, so they share arrays
+        if (source.compressed)
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &source.format);
+
+        // levels that exist: the full chain of mipmapped textures, only the base of the ones that weren't
+        GLint minFilter = GL_LINEAR;
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+        GLint fullChain = 1;
+        while ((std::max(source.width, source.height) >> fullChain) > 0)
+            fullChain++;
+        bool mipmapped = minFilter != GL_LINEAR && minFilter != GL_NEAREST;
+        source.levels = mipmapped ? std::min(fullChain, maxLevel + 1) : 1;
+
+        for (GLint level = 0; level < source.levels; level++)
+        {
+            GLint size = std::max(source.width >> level, 1) * std::max(source.height >> level, 1) * 4;
+            if (source.compressed)
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            source.levelSizes.push_back(size);
+        }
+        return source;
+    }
+};
+#endif
@@ -6,8 +6,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
+#include <learnopengl/multi_draw.h>
 #include <learnopengl/shader.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
@@ -33,6 +36,66 @@ struct Texture {
     string path;
 };
 
+// a layer of a texture array (see MaterialArrays)
+struct MaterialLayer {
+    unsigned int array = 0;
+    unsigned int layer = 0;
+};
+
+// textures of a mesh as layers of texture arrays, for shaders sampling material.diffuse and material.specular
+// as sampler2DArray. The layers reach the shader through the constant vertex attribute MATERIAL_ATTRIBUTE.
+struct MeshMaterial {
+    MaterialLayer diffuse;
+    MaterialLayer specular;
+};
+
+// location of the (diffuse layer, specular layer) attribute of array material shaders
+const unsigned int MATERIAL_ATTRIBUTE = 9;
+
+// number of detail levels of a mesh, level 0 is the full mesh (see MeshOptimizer::GenerateLods)
+const unsigned int LOD_LEVELS = 4;
+
+// a coarser level of detail: triangles over the vertices of the full mesh, and the largest object space
+// distance any vertex was moved by the simplification
+struct MeshDataLod {
+    vector<unsigned int> indices;
+    float error;
+};
+
+// CPU-side mesh data as produced by Assimp or read back from the binary mesh cache.
+// Textures only carry type and path here, the Model resolves them to GL ids.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // levels 1 to LOD_LEVELS - 1, empty if none were generated
+    vector<MeshDataLod>  lods;
+};
+
+// index range of one level of detail inside the index buffer of a mesh
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;
+};
+
+// computes the object space axis aligned bounding box of a set of vertices
+inline void ComputeBounds(const vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+    if (vertices.empty())
+        return;
+    boundsMin = boundsMax = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+}
+
 class Mesh {
 public:
     // mesh Data
@@ -40,7 +103,16 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
+    // object space bounds
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
     unsigned int VAO;
+    // where the mesh starts in the buffers of VAO, non-zero when they are shared with other meshes
+    unsigned int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    // index ranges of the detail levels, lods[0] is the full mesh
+    vector<MeshLod> lods;
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -48,22 +120,178 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        ComputeBounds(this->vertices, boundsMin, boundsMax);
+        lods.push_back({0, (unsigned int)this->indices.size(), 0.0f});
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
+    // constructor for a mesh stored in a model's GeometryArena: geometry was already uploaded to the shared
+    // buffers at baseVertex and is drawn with the arena's VAO. lods holds the index range of every level,
+    // starting with the full mesh. Bounds are taken as they are.
+    Mesh(MeshData &&data, vector<Texture> textures, unsigned int VAO, unsigned int baseVertex, vector<MeshLod> lods)
+    {
+        this->vertices = std::move(data.vertices);
+        this->indices = std::move(data.indices);
+        this->textures = std::move(textures);
+        boundsMin = data.boundsMin;
+        boundsMax = data.boundsMax;
+        this->VAO = VAO;
+        this->baseVertex = baseVertex;
+        this->firstIndex = lods[0].firstIndex;
+        this->lods = std::move(lods);
+    }
+
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
+        bindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        DrawElements();
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render count instances of the mesh, the per-instance model matrices come from the instance attributes of VAO (see Model::UploadInstances)
+    void DrawInstanced(Shader &shader, unsigned int count)
+    {
+        bindTextures(shader);
+
+        glBindVertexArray(VAO);
+        DrawElements(count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // issues the draw call only, VAO and textures have to be bound already. instanceCount 0 draws without instancing.
+    // levels the mesh doesn't have fall back to its coarsest one.
+    void DrawElements(unsigned int instanceCount = 0, unsigned int lod = 0)
+    {
+        const MeshLod &range = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+        void *offset = (void*)(range.firstIndex * sizeof(unsigned int));
+        if (instanceCount > 0)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, offset, instanceCount, baseVertex);
+        else
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, offset, baseVertex);
+    }
+
+    // the same draw as DrawElements as a command for glMultiDrawElementsIndirect, whose instances start at baseInstance
+    DrawElementsIndirectCommand IndirectCommand(unsigned int instanceCount, unsigned int lod, unsigned int baseInstance) const
+    {
+        const MeshLod &range = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+        DrawElementsIndirectCommand command;
+        command.count = range.indexCount;
+        command.instanceCount = std::max(instanceCount, 1u);
+        command.firstIndex = range.firstIndex;
+        command.baseVertex = (GLint)baseVertex;
+        command.baseInstance = baseInstance;
+        return command;
+    }
+
+    // triangles drawn at a level of detail
+    unsigned int TriangleCount(unsigned int lod = 0) const
+    {
+        return lods[std::min(lod, (unsigned int)lods.size() - 1)].indexCount / 3;
+    }
+
+    // textures bound through the state cache, used by the render queue. Unlike Draw this leaves
+    // the textures bound, so the next mesh with the same material doesn't need to rebind them.
+    void BindTextures(Shader &shader, GLStateCache &state)
+    {
+        const SamplerBinding &binding = samplersFor(shader);
+        if (binding.arrays)
+        {
+            shader.set(binding.samplers[0], 0);
+            shader.set(binding.samplers[1], 1);
+            state.BindTexture2DArray(0, material.diffuse.array);
+            state.BindTexture2DArray(1, material.specular.array);
+            state.VertexAttrib2f(MATERIAL_ATTRIBUTE, (float)material.diffuse.layer, (float)material.specular.layer);
+            return;
+        }
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            shader.set(binding.samplers[i], (int)i);
+            state.BindTexture2D(i, textures[i].id);
+        }
+    }
+
+    // texture arrays and layers of the textures, used instead of them by shaders that sample arrays
+    MeshMaterial material;
+
+    // render queue material id (see RenderQueue), -1 until assigned
+    int materialID = -1;
+
+private:
+    // render data, only owned by meshes that aren't part of an arena
+    unsigned int VBO = 0, EBO = 0;
+
+    // sampler uniforms of the textures, resolved once per shader.
+    // For shaders sampling arrays these are the diffuse and specular array samplers.
+    struct SamplerBinding {
+        unsigned int shaderID;
+        std::string prefix;
+        bool arrays;
+        vector<Uniform<int>> samplers;
+    };
+    vector<SamplerBinding> samplerBindings;
+
+    // binds the textures to consecutive units and points the material samplers at them
+    void bindTextures(Shader &shader)
+    {
+        const SamplerBinding &binding = samplersFor(shader);
+        if (binding.arrays)
+        {
+            shader.set(binding.samplers[0], 0);
+            shader.set(binding.samplers[1], 1);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, material.diffuse.array);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, material.specular.array);
+            glVertexAttrib2f(MATERIAL_ATTRIBUTE, (float)material.diffuse.layer, (float)material.specular.layer);
+            return;
+        }
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit, a no-op once the shader remembers it
+            shader.set(binding.samplers[i], (int)i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    const SamplerBinding &samplersFor(Shader &shader)
+    {
+        for (const SamplerBinding &binding : samplerBindings)
+            if (binding.shaderID == shader.ID && binding.prefix == glslIdentifierPrefix)
+                return binding;
+
+        SamplerBinding binding;
+        binding.shaderID = shader.ID;
+        binding.prefix = glslIdentifierPrefix;
+        Uniform<int> diffuseArray = shader.GetUniform<int>((glslIdentifierPrefix + "diffuse").c_str());
+        binding.arrays = diffuseArray.slot >= 0;
+        if (binding.arrays)
+        {
+            binding.samplers.push_back(diffuseArray);
+            binding.samplers.push_back(shader.GetUniform<int>((glslIdentifierPrefix + "specular").c_str()));
+            samplerBindings.push_back(binding);
+            return samplerBindings.back();
+        }
+
+        // build the sampler names once: texture_diffuseN, texture_specularN, ...
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,28 +303,12 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            binding.samplers.push_back(shader.GetUniform<int>((glslIdentifierPrefix + name + number).c_str()));
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        samplerBindings.push_back(binding);
+        return samplerBindings.back();
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -0,0 +1,368 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+        data = (const unsigned char *)mapping;
+        size = (size_t)info.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if (data)
+            munmap((void *)data, size);
+        data = nullptr;
+        size = 0;
+    }
+};
+
+// 64-bit FNV-1a, used to detect changed source assets
+inline uint64_t HashBytes(const unsigned char *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline bool HashFile(const string &path, uint64_t &hash)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    hash = HashBytes(file.data, file.size);
+    return true;
+}
+
+// nanosecond modification time, so edits within the same second are noticed too
+inline int64_t FileModificationTime(const struct stat &info)
+{
+#ifdef __APPLE__
+    return (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+// Binary cache of the processed meshes of a model. The cache lives next to the source asset
+// (<source>.meshcache) and is laid out so it can be mapped and copied out without any parsing:
+//
+//   Header
+//   Entry[meshCount]
+//   texture table (per texture: uint32 type length, uint32 path length, type chars, path chars)
+//   vertex data (Vertex[], 16 byte aligned, per mesh)
+//   index data (uint32[], per mesh: the full mesh followed by its detail levels)
+//
+// The cache is only used when the source file size and mtime (or, if the mtime changed, its content hash)
+// and the import flags match what was recorded when it was written.
+// The meshes are stored after MeshOptimizer ran on them. VERSION changes whenever the layout or the
+// processing changes, which invalidates existing caches.
+//   1: initial layout
+//   2: meshes are welded and reordered by MeshOptimizer
+//   3: detail levels
+class MeshCache
+{
+public:
+    static const uint32_t VERSION = 3;
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t meshCount;
+        uint32_t importFlags;
+        uint32_t vertexSize;
+        uint64_t sourceSize;
+        int64_t  sourceMTime;
+        uint64_t sourceHash;
+        // how long the Assimp import took when the cache was written, kept for the load report
+        double   coldLoadMs;
+    };
+
+    struct Entry {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t textureOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t lodCount;
+        float    boundsMin[3];
+        float    boundsMax[3];
+        // levels 1 to LOD_LEVELS - 1, stored right after the indices of the full mesh
+        uint32_t lodIndexCount[LOD_LEVELS - 1];
+        float    lodError[LOD_LEVELS - 1];
+    };
+
+    static string PathFor(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // the cache can be switched off with LOGL_MESH_CACHE=0, e.g. to measure cold loads
+    static bool Enabled()
+    {
+        static const char *env = getenv("LOGL_MESH_CACHE");
+        static bool enabled = !(env != nullptr && strcmp(env, "0") == 0);
+        return enabled;
+    }
+
+    // reads the cached meshes of sourcePath, returns false if there is no valid cache
+    static bool Load(const string &sourcePath, uint32_t importFlags, vector<MeshData> &meshes, double &coldLoadMs)
+    {
+        struct stat source;
+        if (!Enabled() || stat(sourcePath.c_str(), &source) != 0)
+            return false;
+
+        MappedFile file;
+        if (!file.open(PathFor(sourcePath)) || file.size < sizeof(Header))
+            return false;
+
+        Header header;
+        memcpy(&header, file.data, sizeof(Header));
+        if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != VERSION ||
+            header.importFlags != importFlags || header.vertexSize != sizeof(Vertex) ||
+            header.sourceSize != (uint64_t)source.st_size)
+            return false;
+        if (header.sourceMTime != FileModificationTime(source))
+        {
+            // the file was touched (e.g. by a checkout), only rebuild if its content really changed
+            uint64_t hash;
+            if (!HashFile(sourcePath, hash) || hash != header.sourceHash)
+                return false;
+        }
+
+        const uint64_t entriesEnd = sizeof(Header) + (uint64_t)header.meshCount * sizeof(Entry);
+        if (entriesEnd > file.size)
+            return false;
+
+        meshes.clear();
+        meshes.resize(header.meshCount);
+        for (uint32_t i = 0; i < header.meshCount; i++)
+        {
+            Entry entry;
+            memcpy(&entry, file.data + sizeof(Header) + i * sizeof(Entry), sizeof(Entry));
+            if (entry.lodCount > LOD_LEVELS - 1)
+                return false;
+            uint64_t totalIndexCount = entry.indexCount;
+            for (uint32_t level = 0; level < entry.lodCount; level++)
+                totalIndexCount += entry.lodIndexCount[level];
+            if (!inRange(file, entry.vertexOffset, (uint64_t)entry.vertexCount * sizeof(Vertex)) ||
+                !inRange(file, entry.indexOffset, totalIndexCount * sizeof(unsigned int)))
+                return false;
+
+            MeshData &mesh = meshes[i];
+            const Vertex *vertices = (const Vertex *)(file.data + entry.vertexOffset);
+            const unsigned int *indices = (const unsigned int *)(file.data + entry.indexOffset);
+            mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+            mesh.indices.assign(indices, indices + entry.indexCount);
+            indices += entry.indexCount;
+            mesh.lods.resize(entry.lodCount);
+            for (uint32_t level = 0; level < entry.lodCount; level++)
+            {
+                mesh.lods[level].indices.assign(indices, indices + entry.lodIndexCount[level]);
+                mesh.lods[level].error = entry.lodError[level];
+                indices += entry.lodIndexCount[level];
+            }
+            mesh.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+            mesh.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+
+            uint64_t offset = entry.textureOffset;
+            for (uint32_t j = 0; j < entry.textureCount; j++)
+            {
+                uint32_t lengths[2];
+                if (!inRange(file, offset, sizeof(lengths)))
+                    return false;
+                memcpy(lengths, file.data + offset, sizeof(lengths));
+                offset += sizeof(lengths);
+                if (!inRange(file, offset, (uint64_t)lengths[0] + lengths[1]))
+                    return false;
+                Texture texture;
+                texture.id = 0;
+                texture.type.assign((const char *)file.data + offset, lengths[0]);
+                texture.path.assign((const char *)file.data + offset + lengths[0], lengths[1]);
+                offset += lengths[0] + lengths[1];
+                mesh.textures.push_back(texture);
+            }
+        }
+        coldLoadMs = header.coldLoadMs;
+        return true;
+    }
+
+    // writes the meshes of sourcePath to its cache file, failures are reported but not fatal
+    static bool Store(const string &sourcePath, uint32_t importFlags, const vector<MeshData> &meshes, double coldLoadMs)
+    {
+        struct stat source;
+        uint64_t hash;
+        if (!Enabled() || stat(sourcePath.c_str(), &source) != 0 || !HashFile(sourcePath, hash))
+            return false;
+
+        Header header;
+        memset(&header, 0, sizeof(Header));
+        memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version = VERSION;
+        header.meshCount = (uint32_t)meshes.size();
+        header.importFlags = importFlags;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceSize = (uint64_t)source.st_size;
+        header.sourceMTime = FileModificationTime(source);
+        header.sourceHash = hash;
+        header.coldLoadMs = coldLoadMs;
+
+        // lay out the file: header, entries, texture table, then the aligned vertex and index blobs
+        vector<Entry> entries(meshes.size());
+        memset(entries.data(), 0, entries.size() * sizeof(Entry));
+        uint64_t offset = sizeof(Header) + meshes.size() * sizeof(Entry);
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            entries[i].textureOffset = offset;
+            entries[i].textureCount = (uint32_t)meshes[i].textures.size();
+            for (const Texture &texture : meshes[i].textures)
+                offset += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+        }
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            offset = align(offset);
+            entries[i].vertexOffset = offset;
+            entries[i].vertexCount = (uint32_t)meshes[i].vertices.size();
+            offset += meshes[i].vertices.size() * sizeof(Vertex);
+        }
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            entries[i].indexOffset = offset;
+            entries[i].indexCount = (uint32_t)meshes[i].indices.size();
+            offset += meshes[i].indices.size() * sizeof(unsigned int);
+            entries[i].lodCount = (uint32_t)std::min(meshes[i].lods.size(), (size_t)LOD_LEVELS - 1);
+            for (uint32_t level = 0; level < entries[i].lodCount; level++)
+            {
+                entries[i].lodIndexCount[level] = (uint32_t)meshes[i].lods[level].indices.size();
+                entries[i].lodError[level] = meshes[i].lods[level].error;
+                offset += meshes[i].lods[level].indices.size() * sizeof(unsigned int);
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                entries[i].boundsMin[k] = meshes[i].boundsMin[k];
+                entries[i].boundsMax[k] = meshes[i].boundsMax[k];
+            }
+        }
+
+        // write to a temporary file and rename it, so a crash never leaves a half written cache behind
+        const string cachePath = PathFor(sourcePath);
+        const string tempPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                std::cout << "ERROR::MESH_CACHE:: could not write " << tempPath << std::endl;
+                return false;
+            }
+            out.write((const char *)&header, sizeof(Header));
+            out.write((const char *)entries.data(), entries.size() * sizeof(Entry));
+            for (const MeshData &mesh : meshes)
+            {
+                for (const Texture &texture : mesh.textures)
+                {
+                    uint32_t lengths[2] = {(uint32_t)texture.type.size(), (uint32_t)texture.path.size()};
+                    out.write((const char *)lengths, sizeof(lengths));
+                    out.write(texture.type.data(), texture.type.size());
+                    out.write(texture.path.data(), texture.path.size());
+                }
+            }
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                pad(out, entries[i].vertexOffset);
+                out.write((const char *)meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+            }
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                out.write((const char *)meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+                for (uint32_t level = 0; level < entries[i].lodCount; level++)
+                    out.write((const char *)meshes[i].lods[level].indices.data(), meshes[i].lods[level].indices.size() * sizeof(unsigned int));
+            }
+            if (!out)
+            {
+                std::cout << "ERROR::MESH_CACHE:: could not write " << tempPath << std::endl;
+                out.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    // 7 characters plus the terminator fill Header::magic
+    static const char *magic()
+    {
+        return "LOGLMSH";
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    static void pad(std::ofstream &out, uint64_t offset)
+    {
+        static const char zeros[16] = {0};
+        uint64_t position = (uint64_t)out.tellp();
+        if (offset > position)
+            out.write(zeros, offset - position);
+    }
+
+    static bool inRange(const MappedFile &file, uint64_t offset, uint64_t size)
+    {
+        return offset <= file.size && size <= file.size - offset;
+    }
+};
+#endif
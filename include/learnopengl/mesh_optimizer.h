@@ -0,0 +1,452 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Load-time optimization of indexed triangle meshes, run once before the mesh cache stores them:
+//   1. Weld: merges vertices that are bitwise identical (Assimp emits one vertex per face corner)
+//   2. OptimizeVertexCache: reorders triangles for the post-transform cache (Tipsify, Sander et al. 2007)
+//   3. OptimizeOverdraw: reorders clusters of that result so outer surfaces come first
+//   4. OptimizeVertexFetch: renumbers vertices in order of first use, so fetches walk memory linearly
+// GenerateLods then adds coarser index buffers over the same vertices.
+namespace MeshOptimizer
+{
+    // post-transform cache size that is optimized for and simulated by ACMR
+    const unsigned int CACHE_SIZE = 16;
+
+    // average cache miss ratio: transformed vertices per triangle with a FIFO cache of cacheSize entries.
+    // 3 is the worst case, 0.5 the best possible for large regular meshes.
+    inline float ACMR(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE)
+    {
+        if (indices.size() < 3)
+            return 0.0f;
+        // a vertex is in the FIFO while fewer than cacheSize misses happened after its own
+        vector<unsigned int> insertedAt(vertexCount, 0);
+        vector<unsigned char> seen(vertexCount, 0);
+        unsigned int misses = 0;
+        for (unsigned int index : indices)
+        {
+            if (!seen[index] || misses - insertedAt[index] >= cacheSize)
+            {
+                insertedAt[index] = misses;
+                seen[index] = 1;
+                misses++;
+            }
+        }
+        return (float)misses / (float)(indices.size() / 3);
+    }
+
+    // merges bitwise identical vertices and rewrites the indices, returns the number of vertices removed
+    inline size_t Weld(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        struct VertexHash {
+            size_t operator()(const Vertex *vertex) const
+            {
+                return (size_t)HashBytes((const unsigned char *)vertex, sizeof(Vertex));
+            }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex *a, const Vertex *b) const
+            {
+                return memcmp(a, b, sizeof(Vertex)) == 0;
+            }
+        };
+
+        vector<unsigned int> remap(vertices.size());
+        vector<Vertex> unique;
+        unique.reserve(vertices.size());
+        // keys point into vertices, which isn't touched until the map is gone
+        unordered_map<const Vertex *, unsigned int, VertexHash, VertexEqual> lookup(vertices.size() * 2);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto inserted = lookup.insert(std::make_pair(&vertices[i], (unsigned int)unique.size()));
+            if (inserted.second)
+                unique.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        lookup.clear();
+
+        for (unsigned int &index : indices)
+            index = remap[index];
+        size_t removed = vertices.size() - unique.size();
+        vertices.swap(unique);
+        return removed;
+    }
+
+    // Tipsify: fans around a vertex as long as its neighbourhood is likely still cached and jumps to the
+    // most recently used dead end otherwise. Linear in the number of triangles.
+    // hardBoundaries receives the triangle indices (into the new order) where the walk had to jump.
+    inline void OptimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount, vector<unsigned int> &hardBoundaries,
+                                    unsigned int cacheSize = CACHE_SIZE)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        hardBoundaries.clear();
+        if (triangleCount == 0)
+            return;
+
+        // vertex -> triangle adjacency as offsets into one array
+        vector<unsigned int> liveTriangles(vertexCount, 0);
+        for (unsigned int index : indices)
+            liveTriangles[index]++;
+        vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+        vector<unsigned int> cacheTime(vertexCount, 0);
+        vector<unsigned char> emitted(triangleCount, 0);
+        vector<unsigned int> deadEnds;
+        vector<unsigned int> candidates;
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        unsigned int timestamp = cacheSize + 1;
+        size_t cursor = 0;
+        int fanning = 0;
+        while (fanning >= 0)
+        {
+            candidates.clear();
+            for (unsigned int a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                for (unsigned int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[triangle * 3 + corner];
+                    result.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (timestamp - cacheTime[v] > cacheSize)
+                        cacheTime[v] = timestamp++;
+                }
+                emitted[triangle] = 1;
+            }
+
+            // next fanning vertex: the candidate that will still be in the cache after its remaining triangles
+            // are emitted and has been in there the longest. The others have no priority and aren't fanned from
+            // here, as in Tipsify, they get their turn through the dead end stack
+            int best = -1;
+            int bestPriority = 0;
+            for (unsigned int v : candidates)
+            {
+                if (liveTriangles[v] == 0)
+                    continue;
+                int priority = 0;
+                if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                    priority = (int)(timestamp - cacheTime[v]);
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    best = (int)v;
+                }
+            }
+            if (best >= 0)
+            {
+                fanning = best;
+                continue;
+            }
+
+            // dead end: most recently referenced vertex that still has triangles, then the input order
+            fanning = -1;
+            while (!deadEnds.empty())
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                {
+                    fanning = (int)v;
+                    break;
+                }
+            }
+            if (fanning < 0)
+            {
+                while (cursor < vertexCount && liveTriangles[cursor] == 0)
+                    cursor++;
+                if (cursor < vertexCount)
+                    fanning = (int)cursor;
+            }
+            if (fanning >= 0)
+                hardBoundaries.push_back((unsigned int)(result.size() / 3));
+        }
+        indices.swap(result);
+    }
+
+    // Splits the cache optimized order into clusters and sorts those so that triangles facing away from the
+    // mesh center are drawn first, which lets early depth testing reject more of what lies behind them.
+    // Clusters end at the hard boundaries of OptimizeVertexCache and, inside those, wherever the running ACMR
+    // is already within threshold of the whole mesh, so the cache efficiency only degrades by that factor.
+    inline void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices,
+                                 const vector<unsigned int> &hardBoundaries, float threshold = 1.05f,
+                                 unsigned int cacheSize = CACHE_SIZE)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        // cluster boundaries
+        float meshACMR = ACMR(indices, vertices.size(), cacheSize);
+        vector<unsigned int> clusterStart;
+        {
+            vector<unsigned int> insertedAt(vertices.size(), 0);
+            vector<unsigned int> seenInCluster(vertices.size(), 0);
+            unsigned int misses = 0, clusterMisses = 0, clusterId = 0;
+            size_t hard = 0;
+            size_t start = 0;
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                bool atHardBoundary = hard < hardBoundaries.size() && hardBoundaries[hard] == t;
+                if (atHardBoundary)
+                    hard++;
+                bool softBoundary = t > start && (float)clusterMisses / (float)(t - start) <= meshACMR * threshold;
+                if (t == 0 || atHardBoundary || softBoundary)
+                {
+                    clusterStart.push_back((unsigned int)t);
+                    start = t;
+                    clusterMisses = 0;
+                    // every cluster starts with a cold cache, it may be drawn after any other
+                    clusterId++;
+                }
+                for (unsigned int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[t * 3 + corner];
+                    if (seenInCluster[v] != clusterId || misses - insertedAt[v] >= cacheSize)
+                    {
+                        insertedAt[v] = misses;
+                        seenInCluster[v] = clusterId;
+                        misses++;
+                        clusterMisses++;
+                    }
+                }
+            }
+        }
+        clusterStart.push_back((unsigned int)triangleCount);
+        const size_t clusterCount = clusterStart.size() - 1;
+        if (clusterCount < 2)
+            return;
+
+        // mesh centroid, area weighted
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+            float area = glm::length(glm::cross(b - a, c - a));
+            meshCenter += (a + b + c) * (area / 3.0f);
+            meshArea += area;
+        }
+        meshCenter /= std::max(meshArea, 1e-12f);
+
+        // sort key of a cluster: how much its average normal points away from the mesh center
+        vector<std::pair<float, unsigned int>> order(clusterCount);
+        for (size_t cluster = 0; cluster < clusterCount; cluster++)
+        {
+            glm::vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (unsigned int t = clusterStart[cluster]; t < clusterStart[cluster + 1]; t++)
+            {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 weightedNormal = glm::cross(b - a, c - a);
+                float triangleArea = glm::length(weightedNormal);
+                center += (a + b + c) * (triangleArea / 3.0f);
+                normal += weightedNormal;
+                area += triangleArea;
+            }
+            center /= std::max(area, 1e-12f);
+            float normalLength = glm::length(normal);
+            float outward = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+            order[cluster] = std::make_pair(-outward, (unsigned int)cluster);
+        }
+        std::stable_sort(order.begin(), order.end());
+
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (const std::pair<float, unsigned int> &entry : order)
+            result.insert(result.end(), indices.begin() + clusterStart[entry.second] * 3,
+                          indices.begin() + clusterStart[entry.second + 1] * 3);
+        indices.swap(result);
+    }
+
+    // renumbers vertices in the order the indices first reference them, unreferenced vertices are dropped
+    inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        const unsigned int UNUSED = 0xFFFFFFFFu;
+        vector<unsigned int> remap(vertices.size(), UNUSED);
+        vector<Vertex> result;
+        result.reserve(vertices.size());
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == UNUSED)
+            {
+                remap[index] = (unsigned int)result.size();
+                result.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(result);
+    }
+
+    // Vertex clustering (Rossignac and Borrel): vertices are snapped to the one closest to the average of their
+    // grid cell and triangles that collapse are dropped. Vertices whose normals point into different octants are
+    // kept apart so thin parts don't fold onto their back side. Returns the largest distance a vertex was moved.
+    inline float SimplifyClustered(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const glm::vec3 &origin,
+                                   float cellSize, vector<unsigned int> &result)
+    {
+        result.clear();
+        if (indices.empty())
+            return 0.0f;
+
+        // grid cell and normal octant of every vertex
+        vector<uint64_t> cellOf(vertices.size());
+        unordered_map<uint64_t, unsigned int> clusterOf(vertices.size());
+        vector<unsigned int> vertexCluster(vertices.size());
+        vector<glm::vec3> clusterSum;
+        vector<unsigned int> clusterCount;
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            glm::vec3 cell = glm::floor((vertices[v].Position - origin) / cellSize);
+            const glm::vec3 &normal = vertices[v].Normal;
+            uint64_t key = ((uint64_t)((int64_t)cell.x & 0xFFFFF)) | ((uint64_t)((int64_t)cell.y & 0xFFFFF) << 20) |
+                           ((uint64_t)((int64_t)cell.z & 0xFFFFF) << 40) |
+                           ((uint64_t)((normal.x < 0.0f) | (normal.y < 0.0f) << 1 | (normal.z < 0.0f) << 2) << 60);
+            auto inserted = clusterOf.insert(std::make_pair(key, (unsigned int)clusterSum.size()));
+            if (inserted.second)
+            {
+                clusterSum.push_back(glm::vec3(0.0f));
+                clusterCount.push_back(0);
+            }
+            vertexCluster[v] = inserted.first->second;
+            clusterSum[vertexCluster[v]] += vertices[v].Position;
+            clusterCount[vertexCluster[v]]++;
+        }
+
+        // representative: the existing vertex closest to the cluster average, so no new vertices are needed
+        const unsigned int NONE = 0xFFFFFFFFu;
+        vector<unsigned int> representative(clusterSum.size(), NONE);
+        vector<float> representativeDistance(clusterSum.size(), 0.0f);
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            unsigned int cluster = vertexCluster[v];
+            glm::vec3 average = clusterSum[cluster] / (float)clusterCount[cluster];
+            float distance = glm::length(vertices[v].Position - average);
+            if (representative[cluster] == NONE || distance < representativeDistance[cluster])
+            {
+                representative[cluster] = (unsigned int)v;
+                representativeDistance[cluster] = distance;
+            }
+        }
+
+        float error = 0.0f;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            unsigned int a = representative[vertexCluster[indices[i]]];
+            unsigned int b = representative[vertexCluster[indices[i + 1]]];
+            unsigned int c = representative[vertexCluster[indices[i + 2]]];
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[i + corner];
+                error = std::max(error, glm::length(vertices[v].Position - vertices[representative[vertexCluster[v]]].Position));
+            }
+            if (a == b || b == c || a == c)
+                continue;
+            result.push_back(a);
+            result.push_back(b);
+            result.push_back(c);
+        }
+        return error;
+    }
+
+    // Adds LOD_LEVELS - 1 coarser levels to every mesh of a model. The grid is shared by all meshes of the model
+    // and doubles in cell size per level, starting at 1/96 of the model's bounding box diagonal.
+    inline void GenerateLods(vector<MeshData> &meshes)
+    {
+        if (meshes.empty())
+            return;
+        glm::vec3 modelMin = meshes[0].boundsMin, modelMax = meshes[0].boundsMax;
+        for (const MeshData &mesh : meshes)
+        {
+            modelMin = glm::min(modelMin, mesh.boundsMin);
+            modelMax = glm::max(modelMax, mesh.boundsMax);
+        }
+        float diagonal = glm::length(modelMax - modelMin);
+        if (diagonal <= 0.0f)
+            return;
+
+        vector<unsigned int> hardBoundaries;
+        for (MeshData &mesh : meshes)
+        {
+            mesh.lods.clear();
+            float cellSize = diagonal / 96.0f;
+            float previousError = 0.0f;
+            for (unsigned int level = 1; level < LOD_LEVELS; level++, cellSize *= 2.0f)
+            {
+                MeshDataLod lod;
+                // errors only grow with the level, so selection can walk the levels in order
+                lod.error = std::max(previousError, SimplifyClustered(mesh.vertices, mesh.indices, modelMin, cellSize, lod.indices));
+                OptimizeVertexCache(lod.indices, mesh.vertices.size(), hardBoundaries);
+                previousError = lod.error;
+                mesh.lods.push_back(std::move(lod));
+            }
+        }
+    }
+
+    // what Optimize did to one model
+    struct Report {
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        size_t triangles = 0;
+        // transformed vertices, summed over all meshes, divided by the triangles
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+    };
+
+    // runs all passes on one mesh
+    inline void Optimize(MeshData &mesh, Report &report)
+    {
+        size_t triangles = mesh.indices.size() / 3;
+        report.verticesBefore += mesh.vertices.size();
+        report.triangles += triangles;
+        report.acmrBefore += ACMR(mesh.indices, mesh.vertices.size()) * triangles;
+
+        Weld(mesh.vertices, mesh.indices);
+        vector<unsigned int> hardBoundaries;
+        OptimizeVertexCache(mesh.indices, mesh.vertices.size(), hardBoundaries);
+        OptimizeOverdraw(mesh.indices, mesh.vertices, hardBoundaries);
+        OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+        report.verticesAfter += mesh.vertices.size();
+        report.acmrAfter += ACMR(mesh.indices, mesh.vertices.size()) * triangles;
+    }
+
+    inline Report Optimize(vector<MeshData> &meshes)
+    {
+        Report report;
+        for (MeshData &mesh : meshes)
+            Optimize(mesh, report);
+        if (report.triangles > 0)
+        {
+            report.acmrBefore /= report.triangles;
+            report.acmrAfter /= report.triangles;
+        }
+        return report;
+    }
+}
+#endif
@@ -10,14 +10,24 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/material_arrays.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/texture_registry.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -29,10 +39,16 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// the textures of this model, each holds one reference in the TextureRegistry
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    std::string glslIdentifierPrefix;
+    // object space bounds of all meshes
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // object space error of every detail level, the largest of all meshes
+    float lodErrors[LOD_LEVELS] = {0.0f};
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -40,6 +56,11 @@ public:
         loadModel(path);
     }
 
+    // constructor for a model whose meshes are streamed in later (see AssetLoader)
+    explicit Model(bool gamma = false) : gammaCorrection(gamma)
+    {
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -47,33 +68,308 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws count instances of the model with a single draw call per mesh.
+    // transforms holds the model matrix of every instance and is streamed into the instance buffer.
+    void DrawInstanced(Shader &shader, const glm::mat4 *transforms, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        UploadInstances(transforms, count);
+        glBindVertexArray(geometry.VAO);
+        SetFirstInstance(0);
+        glBindVertexArray(0);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, count);
+    }
+
+    // instanced draws start at instance firstInstance of the uploaded transforms. Expects the VAO of the meshes to be bound.
+    void SetFirstInstance(unsigned int firstInstance)
+    {
+        if (firstInstance == instanceOffset)
+            return;
+        geometry.PointInstanceAttributes(instanceVBO, firstInstance);
+        instanceOffset = firstInstance;
+    }
+
+    // VAO for indirect draws of the meshes, with per-instance data from instanceBuffer (see GeometryArena::IndirectVAO)
+    unsigned int IndirectVAO(unsigned int instanceBuffer)
+    {
+        return geometry.IndirectVAO(instanceBuffer);
+    }
+
+    // VAO for depth only draws of the meshes: positions only, model matrices from instanceBuffer (see GeometryArena::DepthVAO)
+    unsigned int DepthVAO(unsigned int instanceBuffer)
+    {
+        return geometry.DepthVAO(instanceBuffer);
+    }
+
+    // makes instance 0 of the next depth draws read the matrix at firstInstance of instanceBuffer, expects DepthVAO to be bound
+    void SetFirstDepthInstance(unsigned int instanceBuffer, unsigned int firstInstance)
+    {
+        geometry.PointInstanceAttributes(instanceBuffer, firstInstance);
+    }
+
+    // the coarsest detail level whose error covers at most maxErrorPixels on screen.
+    // pixelsPerUnit is the screen size of one object space unit at the model's distance (see ProjectedPixelsPerUnit).
+    unsigned int SelectLod(float pixelsPerUnit, float maxErrorPixels) const
+    {
+        for (unsigned int level = LOD_LEVELS - 1; level > 0; level--)
+            if (lodErrors[level] * pixelsPerUnit <= maxErrorPixels)
+                return level;
+        return 0;
+    }
+
+    // streams the per-instance model matrices into the instance buffer shared by all meshes
+    void UploadInstances(const glm::mat4 *transforms, unsigned int count)
+    {
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // reallocating (orphaning) every frame lets the driver hand out fresh storage instead of waiting for the previous draws
+        instanceCapacity = std::max(count, instanceCapacity);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+
+        // all meshes share the VAO of the arena, meshes added later pick the attributes up as well
+        if (!instanceAttributesSet)
+        {
+            geometry.SetupInstanceAttributes(instanceVBO);
+            instanceAttributesSet = true;
+        }
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
+
+    // reads the meshes of a model file from the mesh cache if possible, otherwise with ASSIMP.
+    // only touches CPU data, so it can run on a worker thread.
+    static bool LoadMeshData(string const &path, vector<MeshData> &meshData)
+    {
+        auto start = std::chrono::steady_clock::now();
+        double coldLoadMs = 0.0;
+        bool warm = MeshCache::Load(path, importFlags, meshData, coldLoadMs);
+        if (!warm)
+        {
+            if (!importModel(path, meshData))
+                return false;
+            // the cache stores the optimized meshes, so this only runs on a cold load
+            MeshOptimizer::Report report = MeshOptimizer::Optimize(meshData);
+            cout << "MODEL::OPTIMIZE:: " << path << " " << report.triangles << " triangles, vertices " << report.verticesBefore
+                 << " -> " << report.verticesAfter << ", ACMR " << report.acmrBefore << " -> " << report.acmrAfter << endl;
+            MeshOptimizer::GenerateLods(meshData);
+            coldLoadMs = elapsedMs(start);
+            MeshCache::Store(path, importFlags, meshData, coldLoadMs);
+        }
+        double parseMs = elapsedMs(start);
+
+        // cold vs warm load report
+        if (warm)
+            cout << "MODEL::LOAD:: " << path << " warm (mesh cache) " << parseMs << " ms, cold (assimp) " << coldLoadMs
+                 << " ms, " << coldLoadMs / std::max(parseMs, 0.001) << "x faster" << endl;
+        else
+            cout << "MODEL::LOAD:: " << path << " cold (assimp) " << parseMs << " ms" << endl;
+        return true;
+    }
+
+    // storage format of the vertices on the GPU, has to be set before meshes are added
+    void SetVertexLayout(const VertexLayout &layout)
+    {
+        geometry.SetLayout(layout);
+    }
+
+    // prints the GPU vertex memory of the model against what the unpacked Vertex layout would take
+    void ReportVertexMemory(const string &path) const
+    {
+        size_t vertexCount = geometry.VertexCount();
+        size_t packedBytes = geometry.VertexBytes();
+        size_t fullBytes = vertexCount * sizeof(Vertex);
+        cout << "MODEL::VERTEX_FORMAT:: " << path << " " << vertexCount << " vertices, " << geometry.Layout().Stride()
+             << " bytes per vertex instead of " << sizeof(Vertex) << ", " << packedBytes / 1024 << " KB instead of "
+             << fullBytes / 1024 << " KB (" << (fullBytes - packedBytes) / 1024 << " KB saved), plus "
+             << geometry.PositionBytes() / 1024 << " KB of positions for depth passes" << endl;
+    }
+
+    // copies the textures of all meshes into texture arrays (see MaterialArrays) and points the mesh materials
+    // at their layers. The model's references to the 2D textures are released afterwards, so from then on it has
+    // to be drawn with shaders that sample material.diffuse/material.specular arrays. Needs every texture uploaded.
+    void BuildMaterials(const string &path)
+    {
+        vector<unsigned int> textureIDs;
+        for (const Texture &texture : textures_loaded)
+            textureIDs.push_back(texture.id);
+        materialArrays.Build(textureIDs);
+        for (Mesh &mesh : meshes)
+        {
+            mesh.material = MaterialArrays::PlaceholderMaterial();
+            bool diffuse = false, specular = false;
+            for (const Texture &texture : mesh.textures)
+            {
+                if (texture.type == "texture_diffuse" && !diffuse)
+                {
+                    mesh.material.diffuse = materialArrays.LayerOf(texture.id, MaterialArrays::PLACEHOLDER_DIFFUSE);
+                    diffuse = true;
+                }
+                else if (texture.type == "texture_specular" && !specular)
+                {
+                    mesh.material.specular = materialArrays.LayerOf(texture.id, MaterialArrays::PLACEHOLDER_NO_SPECULAR);
+                    specular = true;
+                }
+            }
+            // the render queue keys materials by their arrays from now on
+            mesh.materialID = -1;
+        }
+        cout << "MODEL::MATERIALS:: " << path << " " << textures_loaded.size() << " textures in " << materialArrays.ArrayCount()
+             << " texture arrays, " << materialArrays.VramBytes() / 1024 << " KB" << endl;
+        ReleaseTextures();
+    }
+
+    // sizes the shared geometry buffers for the meshes about to be added, so AddMesh doesn't have to grow them
+    void ReserveGeometry(const vector<MeshData> &meshData)
+    {
+        size_t vertexCount = geometry.VertexCount();
+        size_t indexCount = geometry.IndexCount();
+        for (const MeshData &data : meshData)
+        {
+            vertexCount += data.vertices.size();
+            indexCount += data.indices.size();
+            for (const MeshDataLod &lod : data.lods)
+                indexCount += lod.indices.size();
+        }
+        geometry.Reserve(vertexCount, indexCount);
+    }
+
+    // turns mesh data into a Mesh stored in the shared geometry buffers of the model,
+    // textures must already be resolved to GL ids. Needs the GL context.
+    void AddMesh(MeshData &&data, vector<Texture> textures)
+    {
+        unsigned int baseVertex, firstIndex;
+        geometry.Append(data.vertices, data.indices, baseVertex, firstIndex);
+        vector<MeshLod> lods;
+        lods.push_back({firstIndex, (unsigned int)data.indices.size(), 0.0f});
+        for (unsigned int level = 1; level <= data.lods.size() && level < LOD_LEVELS; level++)
+        {
+            const MeshDataLod &lod = data.lods[level - 1];
+            lods.push_back({geometry.AppendIndices(lod.indices), (unsigned int)lod.indices.size(), lod.error});
+        }
+        // a mesh without a level draws its coarsest one there
+        for (unsigned int level = 1; level < LOD_LEVELS; level++)
+            lodErrors[level] = std::max(lodErrors[level], lods[std::min(level, (unsigned int)lods.size() - 1)].error);
+        meshes.push_back(Mesh(std::move(data), std::move(textures), geometry.VAO, baseVertex, std::move(lods)));
+        Mesh &mesh = meshes.back();
+        mesh.glslIdentifierPrefix = glslIdentifierPrefix;
+        mesh.material = MaterialArrays::PlaceholderMaterial();
+        boundsMin = meshes.size() == 1 ? mesh.boundsMin : glm::min(boundsMin, mesh.boundsMin);
+        boundsMax = meshes.size() == 1 ? mesh.boundsMax : glm::max(boundsMax, mesh.boundsMax);
+    }
+
+    // resolves texture references to GL ids, loading every path only once per model.
+    // load is called with the full path of each texture that hasn't been loaded yet and returns its id,
+    // which is shared with other models through the TextureRegistry.
+    template <typename TextureLoader>
+    vector<Texture> ResolveTextures(const vector<Texture> &references, TextureLoader load)
+    {
+        vector<Texture> textures;
+        for(const Texture &reference : references)
+        {
+            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
+            auto loaded = textureIndex.find(reference.path);
+            if(loaded != textureIndex.end())
+            {
+                textures.push_back(textures_loaded[loaded->second]);
+                continue;
+            }
+            // if texture hasn't been loaded already, load it
+            Texture texture;
+            texture.id = load(directory + '/' + reference.path);
+            texture.type = reference.type;
+            texture.path = reference.path;
+            textures.push_back(texture);
+            textureIndex[reference.path] = textures_loaded.size();
+            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        }
+        return textures;
+    }
+
+    // gives up the model's references to its textures, the registry deletes the ones no one else uses.
+    // Meshes keep the ids, so this is for models that won't be drawn again.
+    void ReleaseTextures()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureRegistry::Instance().Release(texture.id);
+        textures_loaded.clear();
+        textureIndex.clear();
+    }
+
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // texture arrays the meshes sample their materials from, once BuildMaterials ran
+    MaterialArrays materialArrays;
+
+    // position of every texture path in textures_loaded
+    std::unordered_map<string, size_t> textureIndex;
+
+    // vertices and indices of all meshes, drawn with a single VAO
+    GeometryArena geometry;
+
+    // per-instance model matrices for DrawInstanced
+    unsigned int instanceVBO = 0;
+    unsigned int instanceCapacity = 0;
+    bool instanceAttributesSet = false;
+    // first instance the instance attributes currently point at
+    unsigned int instanceOffset = 0;
+
+    // post processing applied by Assimp, part of the mesh cache key
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // loads a model and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        vector<MeshData> meshData;
+        if (!LoadMeshData(path, meshData))
+            return;
+
+        ReserveGeometry(meshData);
+        for (MeshData &data : meshData)
+        {
+            vector<Texture> textures = ResolveTextures(data.textures, [](const string &texturePath) {
+                return TextureFromFile(texturePath.c_str(), "");
+            });
+            AddMesh(std::move(data), textures);
+        }
+        BuildMaterials(path);
+        ReportVertexMemory(path);
+    }
+
+    // reads the file via ASSIMP and converts its meshes to MeshData
+    static bool importModel(string const &path, vector<MeshData> &meshData)
+    {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, meshData);
+        return true;
+    }
+
+    static double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshData)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,23 +377,23 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vertices.reserve(mesh->mNumVertices);
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -137,7 +433,12 @@ private:
                 vertex.Bitangent = vector;
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                // defined values, identical vertices have to compare equal when they are welded
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
 
             vertices.push_back(vertex);
 
@@ -164,55 +465,33 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
+        ComputeBounds(vertices, data.boundsMin, data.boundsMax);
 
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, textures are loaded once the data is turned into a Mesh
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends the type and path of all material textures of a given type
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<Texture> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
-        return textures;
     }
 };
 
@@ -220,39 +499,24 @@ private:
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
-    filename = directory + '/' + filename;
+    if (!directory.empty())
+        filename = directory + '/' + filename;
+
+    TextureRegistry &registry = TextureRegistry::Instance();
+    string canonicalPath = TextureRegistry::CanonicalPath(filename);
+    uint64_t contentHash = TextureRegistry::ContentHash(filename);
+    if (unsigned int textureID = registry.Acquire(canonicalPath, contentHash))
+        return textureID;
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    registry.Register(textureID, canonicalPath, contentHash);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+    PreparedTexture texture = PrepareTexture2D(filename);
+    if (texture.Valid())
+        UploadPreparedTexture2D(textureID, texture, filename, false);
     else
-    {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
 
     return textureID;
 }
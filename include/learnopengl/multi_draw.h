@@ -0,0 +1,104 @@
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// glMultiDrawElementsIndirect is GL 4.3 (or ARB_multi_draw_indirect), the glad loader of this project
+// only covers 3.3, so the entry point and its constants are declared and loaded here
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+typedef void (APIENTRYP PFNLOGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// one draw of glMultiDrawElementsIndirect, laid out as GL reads it from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// per-instance data of indirect draws, read through the base instance of each command: the model matrix
+// at locations 5 to 8 like Model::UploadInstances, and the material layers at MATERIAL_ATTRIBUTE
+struct IndirectInstance {
+    glm::mat4 model;
+    glm::vec2 materialLayers;
+    glm::vec2 padding;
+};
+
+// Availability of indirect multi draws with a base instance (the RenderQueue uses it to index per-draw data).
+// Without them, or with LOGL_MULTI_DRAW=0, draws are issued one by one as on plain GL 3.3.
+class MultiDrawIndirect
+{
+public:
+    // needs the GL context, call after glad is loaded
+    static void Init(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool supported = major > 4 || (major == 4 && minor >= 3);
+        if (!supported)
+            supported = hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance") &&
+                        hasExtension("GL_ARB_draw_indirect");
+        if (supported)
+        {
+            function() = (PFNLOGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+            if (function() == nullptr)
+                function() = (PFNLOGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirectARB");
+        }
+        if (function() == nullptr)
+            std::cout << "MULTI_DRAW:: glMultiDrawElementsIndirect not available (GL " << major << "." << minor
+                      << "), drawing one mesh per call" << std::endl;
+        const char *env = getenv("LOGL_MULTI_DRAW");
+        enabledByDefault() = function() != nullptr && !(env != nullptr && strcmp(env, "0") == 0);
+    }
+
+    static bool Supported()
+    {
+        return function() != nullptr;
+    }
+
+    // whether multi draws should start out enabled
+    static bool EnabledByDefault()
+    {
+        return enabledByDefault();
+    }
+
+    // drawCount commands of GL_DRAW_INDIRECT_BUFFER starting at byte offset, indices are unsigned ints
+    static void Draw(size_t offset, GLsizei drawCount)
+    {
+        function()(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)offset, drawCount, sizeof(DrawElementsIndirectCommand));
+    }
+
+private:
+    static PFNLOGLMULTIDRAWELEMENTSINDIRECTPROC &function()
+    {
+        static PFNLOGLMULTIDRAWELEMENTSINDIRECTPROC multiDraw = nullptr;
+        return multiDraw;
+    }
+
+    static bool &enabledByDefault()
+    {
+        static bool value = false;
+        return value;
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+};
+#endif
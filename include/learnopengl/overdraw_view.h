@@ -0,0 +1,80 @@
+#ifndef OVERDRAW_VIEW_H
+#define OVERDRAW_VIEW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+// Shows how many fragments were drawn on every pixel. While counting, each fragment that passes the depth test
+// increments the stencil buffer; Draw then paints the screen by those counts, one full screen triangle per level
+// with the stencil test picking its pixels. It doesn't touch the shaders of the counted draws, so every draw path
+// (single, instanced, multi draw) is covered. Needs the 8 stencil bits of the default framebuffer, cleared every frame.
+class OverdrawView
+{
+public:
+    // counts from LEVELS up share the last color
+    static const int LEVELS = 8;
+
+    void Init()
+    {
+        // the triangle is made in fullscreen_triangle.vs, but core profile draws need a bound VAO
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    void Destroy()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+    void BeginCounting()
+    {
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+    }
+
+    void EndCounting()
+    {
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glDisable(GL_STENCIL_TEST);
+    }
+
+    // covers the screen: black where nothing was counted, then blue over green to red for 1 to LEVELS fragments.
+    // overdrawShader is fullscreen_triangle.vs with overdraw.fs.
+    void Draw(Shader &overdrawShader)
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glEnable(GL_STENCIL_TEST);
+        overdrawShader.use();
+        glBindVertexArray(emptyVAO);
+        for (int level = 0; level <= LEVELS; level++)
+        {
+            // the reference is compared to the stored count: equal, or for the last level at most the count
+            glStencilFunc(level == LEVELS ? GL_LEQUAL : GL_EQUAL, level, 0xFF);
+            overdrawShader.setVec3("color", heat(level));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glBindVertexArray(0);
+        glDisable(GL_STENCIL_TEST);
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int emptyVAO = 0;
+
+    static glm::vec3 heat(int level)
+    {
+        if (level == 0)
+            return glm::vec3(0.0f);
+        float t = (float)(level - 1) / (LEVELS - 1);
+        if (t < 0.5f)
+            return glm::mix(glm::vec3(0.0f, 0.2f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), t * 2.0f);
+        return glm::mix(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), t * 2.0f - 1.0f);
+    }
+};
+#endif
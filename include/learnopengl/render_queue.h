@@ -0,0 +1,483 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/model.h>
+#include <learnopengl/multi_draw.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Collects the draws of a frame and submits them sorted by a packed 64-bit key, so consecutive draws
+// share program, material and vertex array as often as possible. Binds go through a GLStateCache,
+// which drops the ones that would not change anything.
+//
+// key layout, most significant first:
+//   4 bits layer | 8 bits program | 16 bits material | 12 bits vertex array | 24 bits depth
+//
+// With multiDraw on (and glMultiDrawElementsIndirect available), runs of draws sharing program, material
+// arrays and vertex array are issued as one indirect multi draw. Their transforms and material layers go
+// into a per-frame instance buffer indexed by base instance, so such draws need a shader reading the model
+// matrix as an instance attribute: instanced draws already do, others need SetInstancedVariant.
+//
+// With depthPrepass on, everything is first drawn depth only, nearest first, from the position streams of the
+// models (GeometryArena::DepthVAO), and then shaded with GL_EQUAL: each covered pixel runs the lighting shader once.
+class RenderQueue
+{
+public:
+    enum Layer {
+        LAYER_OPAQUE = 0
+    };
+
+    // state changes of the last Flush; naive is what submitting in order with every bind issued would have cost
+    struct Stats {
+        GLStateCache::Counters naive;
+        GLStateCache::Counters issued;
+        // triangles drawn, and what they would have been with every mesh at full detail
+        unsigned int triangles = 0;
+        unsigned int trianglesFullDetail = 0;
+        // draw calls that reached GL (a multi draw counts once) and how many of them were multi draws
+        unsigned int drawCalls = 0;
+        unsigned int multiDraws = 0;
+        // CPU time spent in Flush, sorting and building commands included
+        double submitMs = 0.0;
+        // draws of the depth pre-pass
+        unsigned int depthDraws = 0;
+        // samples that passed the depth test in the shading pass, read a few frames late (see GpuQuery)
+        uint64_t shadedSamples = 0;
+    };
+    Stats stats;
+    // with this off the queue keeps submission order and issues every bind (the old immediate path)
+    bool sortAndSkip = true;
+    // batch draws into glMultiDrawElementsIndirect calls, ignored where it isn't supported
+    bool multiDraw = false;
+    // depth only pass before the shading pass, needs SetDepthShader. Set before the submits of a frame.
+    bool depthPrepass = false;
+    // sort strictly nearest first instead of by state, so the depth test rejects more of the later draws
+    bool frontToBack = false;
+
+    // clip planes of the projection the draws are seen through, the depths of the submits are quantized in between
+    void SetDepthRange(float nearPlane, float farPlane)
+    {
+        this->nearPlane = nearPlane;
+        this->farPlane = std::max(farPlane, nearPlane + 1e-3f);
+    }
+
+    // the depth only shader of the pre-pass: position at location 0, model matrix per instance at locations 5 to 8
+    void SetDepthShader(Shader &shader)
+    {
+        depthShader = &shader;
+    }
+
+    // shader drawing the same as shader, but with the model matrix from the instance attributes (locations 5 to 8).
+    // Lets draws submitted with shader join multi draws.
+    void SetInstancedVariant(Shader &shader, Shader &instancedShader)
+    {
+        instancedVariants[shader.ID] = &instancedShader;
+    }
+
+    // one draw per mesh of model with transform set through modelUniform, at detail level lod.
+    // depth is the view space distance.
+    void Submit(Shader &shader, Uniform<glm::mat4> modelUniform, Model &model, const glm::mat4 &transform, float depth,
+                unsigned int lod = 0, Layer layer = LAYER_OPAQUE)
+    {
+        unsigned int transformIndex = (unsigned int)transforms.size();
+        transforms.push_back(transform);
+        for (Mesh &mesh : model.meshes)
+            add(shader, model, mesh, modelUniform, transformIndex, 0, 0, lod, depth, layer);
+    }
+
+    // one instanced draw per mesh of model and detail level. The instance buffer of the model is filled right away,
+    // so a model can only be submitted instanced once per frame.
+    // lodCounts, if given, holds LOD_LEVELS instance counts: instanceTransforms is sorted by level and
+    // the first lodCounts[0] instances are drawn at full detail, the next lodCounts[1] at level 1 and so on.
+    void SubmitInstanced(Shader &shader, Model &model, const glm::mat4 *instanceTransforms, unsigned int count, float depth,
+                         const unsigned int *lodCounts = nullptr, Layer layer = LAYER_OPAQUE)
+    {
+        if (count == 0)
+            return;
+        model.UploadInstances(instanceTransforms, count);
+        // multi draws and the depth pre-pass read the transforms from the queue's own instance buffers
+        unsigned int transformIndex = (unsigned int)transforms.size();
+        if (multiDrawActive() || depthPrepassActive())
+            transforms.insert(transforms.end(), instanceTransforms, instanceTransforms + count);
+        unsigned int firstInstance = 0;
+        for (unsigned int level = 0; level < LOD_LEVELS && firstInstance < count; level++)
+        {
+            unsigned int levelCount = lodCounts ? std::min(lodCounts[level], count - firstInstance) : count;
+            if (levelCount == 0)
+                continue;
+            for (Mesh &mesh : model.meshes)
+                add(shader, model, mesh, Uniform<glm::mat4>(), transformIndex, firstInstance, levelCount, level, depth, layer);
+            firstInstance += levelCount;
+        }
+    }
+
+    // sorts and draws everything submitted since the last Flush.
+    // leaves texture unit 0 active so code drawing outside the queue isn't affected.
+    void Flush(GLStateCache &state)
+    {
+        auto start = std::chrono::steady_clock::now();
+        countNaive();
+
+        if (sortAndSkip && frontToBack)
+            std::sort(order.begin(), order.end(), nearestFirst);
+        else if (sortAndSkip)
+            std::sort(order.begin(), order.end());
+        state.skipRedundant = sortAndSkip;
+        state.Invalidate();
+        state.ResetCounters();
+        stats.triangles = 0;
+        stats.trianglesFullDetail = 0;
+        stats.drawCalls = 0;
+        stats.multiDraws = 0;
+        stats.depthDraws = 0;
+
+        buildBatches();
+        const bool prepass = depthPrepassActive();
+        if (prepass)
+            drawDepth(state);
+
+        if (!shadedSamples.Initialized())
+            shadedSamples.Init();
+        shadedSamples.Begin();
+        if (prepass)
+        {
+            // the depth buffer already holds the nearest surfaces, only fragments of those are shaded
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        if (!commands.empty())
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for (const Batch &batch : batches)
+        {
+            if (batch.commandCount > 0)
+                drawIndirect(batch, state);
+            else
+                draw(items[order[batch.begin].second], state);
+        }
+        if (!commands.empty())
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (prepass)
+        {
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+        shadedSamples.End();
+        stats.shadedSamples = shadedSamples.LastResult();
+        state.ActiveTexture(0);
+        stats.issued = state.counters;
+
+        items.clear();
+        order.clear();
+        transforms.clear();
+        stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    struct DrawItem {
+        Shader *shader;
+        Model *model;
+        Mesh *mesh;
+        Uniform<glm::mat4> modelUniform;
+        unsigned int transformIndex;
+        unsigned int firstInstance;
+        unsigned int instanceCount;
+        unsigned int lod;
+        // program of the multi draw this item can join, null if it has to be drawn on its own
+        Shader *indirectShader;
+    };
+
+    // a run of sorted draws issued together: one multi draw of commandCount commands, or a single draw
+    struct Batch {
+        size_t begin;
+        size_t end;
+        size_t firstCommand;
+        unsigned int commandCount;
+    };
+
+    std::vector<DrawItem> items;
+    // sort key and index into items
+    std::vector<std::pair<uint64_t, unsigned int>> order;
+    std::vector<glm::mat4> transforms;
+    std::map<unsigned int, Shader *> instancedVariants;
+    // set with SetDepthRange
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    // per-frame data of the depth pre-pass: the items nearest first and their model matrices in that order
+    Shader *depthShader = nullptr;
+    std::vector<std::pair<uint64_t, unsigned int>> depthOrder;
+    std::vector<glm::mat4> depthTransforms;
+    unsigned int depthInstanceBuffer = 0;
+    GpuQuery shadedSamples{GL_SAMPLES_PASSED};
+
+    // per-frame data of the multi draws
+    std::vector<Batch> batches;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<IndirectInstance> instances;
+    unsigned int commandBuffer = 0;
+    unsigned int instanceBuffer = 0;
+
+    // small ids for the key, handed out on first use
+    std::map<unsigned int, unsigned int> programIDs;
+    std::map<std::vector<unsigned int>, unsigned int> materialIDs;
+
+    void add(Shader &shader, Model &model, Mesh &mesh, Uniform<glm::mat4> modelUniform, unsigned int transformIndex,
+             unsigned int firstInstance, unsigned int instanceCount, unsigned int lod, float depth, Layer layer)
+    {
+        DrawItem item;
+        item.shader = &shader;
+        item.model = &model;
+        item.mesh = &mesh;
+        item.modelUniform = modelUniform;
+        item.transformIndex = transformIndex;
+        item.firstInstance = firstInstance;
+        item.instanceCount = instanceCount;
+        item.lod = lod;
+        item.indirectShader = nullptr;
+        if (multiDrawActive())
+        {
+            if (instanceCount > 0)
+                item.indirectShader = &shader;
+            else
+            {
+                std::map<unsigned int, Shader *>::iterator variant = instancedVariants.find(shader.ID);
+                if (variant != instancedVariants.end())
+                    item.indirectShader = variant->second;
+            }
+        }
+
+        // items joining multi draws are sorted by the program they are drawn with
+        unsigned int program = item.indirectShader ? item.indirectShader->ID : shader.ID;
+        uint64_t key = (uint64_t)(layer & 0xF) << 60;
+        key |= (uint64_t)(programID(program) & 0xFF) << 52;
+        key |= (uint64_t)(materialID(mesh) & 0xFFFF) << 36;
+        key |= (uint64_t)(mesh.VAO & 0xFFF) << 24;
+        key |= quantizeDepth(depth);
+
+        order.push_back(std::make_pair(key, (unsigned int)items.size()));
+        items.push_back(item);
+    }
+
+    unsigned int programID(unsigned int program)
+    {
+        std::map<unsigned int, unsigned int>::iterator it = programIDs.find(program);
+        if (it != programIDs.end())
+            return it->second;
+        unsigned int id = (unsigned int)programIDs.size();
+        programIDs[program] = id;
+        return id;
+    }
+
+    // meshes using the same texture ids in the same order share a material. Meshes with array materials
+    // only need the same arrays, their layers change without a bind.
+    unsigned int materialID(Mesh &mesh)
+    {
+        if (mesh.materialID >= 0)
+            return (unsigned int)mesh.materialID;
+        std::vector<unsigned int> textureIDs;
+        if (mesh.material.diffuse.array != 0)
+        {
+            textureIDs.push_back(mesh.material.diffuse.array);
+            textureIDs.push_back(mesh.material.specular.array);
+        }
+        else
+            for (const Texture &texture : mesh.textures)
+                textureIDs.push_back(texture.id);
+        std::map<std::vector<unsigned int>, unsigned int>::iterator it = materialIDs.find(textureIDs);
+        if (it == materialIDs.end())
+            it = materialIDs.insert(std::make_pair(textureIDs, (unsigned int)materialIDs.size())).first;
+        mesh.materialID = (int)it->second;
+        return it->second;
+    }
+
+    bool multiDrawActive() const
+    {
+        return multiDraw && MultiDrawIndirect::Supported();
+    }
+
+    bool depthPrepassActive() const
+    {
+        return depthPrepass && depthShader != nullptr;
+    }
+
+    // layer first, then depth, then the state bits
+    static bool nearestFirst(const std::pair<uint64_t, unsigned int> &a, const std::pair<uint64_t, unsigned int> &b)
+    {
+        return std::make_tuple(a.first >> 60, a.first & DEPTH_MASK, a.first, a.second) <
+               std::make_tuple(b.first >> 60, b.first & DEPTH_MASK, b.first, b.second);
+    }
+
+    // draws every item into the depth buffer only, nearest first whatever order the shading pass uses. All
+    // draws read positions only and take their model matrix from one instance buffer, instanced or not.
+    void drawDepth(GLStateCache &state)
+    {
+        depthOrder.clear();
+        for (const std::pair<uint64_t, unsigned int> &entry : order)
+            depthOrder.push_back(std::make_pair(entry.first & DEPTH_MASK, entry.second));
+        std::sort(depthOrder.begin(), depthOrder.end());
+        depthTransforms.clear();
+        for (const std::pair<uint64_t, unsigned int> &entry : depthOrder)
+        {
+            const DrawItem &item = items[entry.second];
+            const glm::mat4 *first = &transforms[item.transformIndex + item.firstInstance];
+            depthTransforms.insert(depthTransforms.end(), first, first + std::max(item.instanceCount, 1u));
+        }
+        if (depthTransforms.empty())
+            return;
+        if (depthInstanceBuffer == 0)
+            glGenBuffers(1, &depthInstanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, depthInstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, depthTransforms.size() * sizeof(glm::mat4), depthTransforms.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        // stencil counts of OverdrawView are about the shading pass
+        glStencilMask(0x00);
+        state.UseProgram(depthShader->ID);
+        unsigned int firstInstance = 0;
+        for (const std::pair<uint64_t, unsigned int> &entry : depthOrder)
+        {
+            const DrawItem &item = items[entry.second];
+            unsigned int instances = std::max(item.instanceCount, 1u);
+            state.BindVertexArray(item.model->DepthVAO(depthInstanceBuffer));
+            item.model->SetFirstDepthInstance(depthInstanceBuffer, firstInstance);
+            item.mesh->DrawElements(instances, item.lod);
+            firstInstance += instances;
+            stats.depthDraws++;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilMask(0xFF);
+    }
+
+    // groups the sorted items into batches: consecutive items with the same program, material and vertex array
+    // that can be drawn indirectly become one multi draw. Fills and uploads the commands and instance data.
+    void buildBatches()
+    {
+        batches.clear();
+        commands.clear();
+        instances.clear();
+        for (size_t i = 0; i < order.size();)
+        {
+            const DrawItem &first = items[order[i].second];
+            Batch batch = {i, i + 1, commands.size(), 0};
+            if (first.indirectShader == nullptr)
+            {
+                batches.push_back(batch);
+                i++;
+                continue;
+            }
+            // the key holds program, material and vertex array above the depth bits
+            const uint64_t bucket = order[i].first >> 24;
+            size_t end = i;
+            while (end < order.size() && (order[end].first >> 24) == bucket && items[order[end].second].indirectShader == first.indirectShader &&
+                   items[order[end].second].model == first.model)
+            {
+                const DrawItem &item = items[order[end].second];
+                commands.push_back(item.mesh->IndirectCommand(item.instanceCount, item.lod, (unsigned int)instances.size()));
+                glm::vec2 layers((float)item.mesh->material.diffuse.layer, (float)item.mesh->material.specular.layer);
+                unsigned int firstTransform = item.transformIndex + item.firstInstance;
+                for (unsigned int k = 0; k < std::max(item.instanceCount, 1u); k++)
+                    instances.push_back({transforms[firstTransform + k], layers, glm::vec2(0.0f)});
+                end++;
+            }
+            batch.end = end;
+            batch.commandCount = (unsigned int)(end - i);
+            batches.push_back(batch);
+            i = end;
+        }
+        if (commands.empty())
+            return;
+
+        if (commandBuffer == 0)
+        {
+            glGenBuffers(1, &commandBuffer);
+            glGenBuffers(1, &instanceBuffer);
+        }
+        // orphaned every frame like the model instance buffers
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(IndirectInstance), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void draw(const DrawItem &item, GLStateCache &state)
+    {
+        state.UseProgram(item.shader->ID);
+        item.mesh->BindTextures(*item.shader, state);
+        state.BindVertexArray(item.mesh->VAO);
+        if (item.instanceCount == 0)
+            item.shader->set(item.modelUniform, transforms[item.transformIndex]);
+        else
+            item.model->SetFirstInstance(item.firstInstance);
+        item.mesh->DrawElements(item.instanceCount, item.lod);
+        countDraw(item, state);
+        stats.drawCalls++;
+    }
+
+    // all items of the batch share program, material arrays and geometry, so the first one binds for all of them
+    void drawIndirect(const Batch &batch, GLStateCache &state)
+    {
+        const DrawItem &first = items[order[batch.begin].second];
+        state.UseProgram(first.indirectShader->ID);
+        first.mesh->BindTextures(*first.indirectShader, state);
+        state.BindVertexArray(first.model->IndirectVAO(instanceBuffer));
+        MultiDrawIndirect::Draw(batch.firstCommand * sizeof(DrawElementsIndirectCommand), (GLsizei)batch.commandCount);
+        for (size_t i = batch.begin; i < batch.end; i++)
+            countDraw(items[order[i].second], state);
+        stats.drawCalls++;
+        stats.multiDraws++;
+    }
+
+    void countDraw(const DrawItem &item, GLStateCache &state)
+    {
+        unsigned int instances = std::max(item.instanceCount, 1u);
+        stats.triangles += item.mesh->TriangleCount(item.lod) * instances;
+        stats.trianglesFullDetail += item.mesh->TriangleCount(0) * instances;
+        state.counters.draws++;
+    }
+
+    static const uint64_t DEPTH_MASK = 0xFFFFFF;
+
+    // front to back within a state bucket: 24 bits over the range between the clip planes
+    uint64_t quantizeDepth(float depth) const
+    {
+        float normalized = std::min(std::max((depth - nearPlane) / (farPlane - nearPlane), 0.0f), 1.0f);
+        return (uint64_t)(normalized * 0xFFFFFF);
+    }
+
+    // counts the binds of submitting in order with no redundancy checks: every draw binds its textures and
+    // its vertex array (and unbinds the latter afterwards, as Mesh::Draw does), programs switch when they differ
+    void countNaive()
+    {
+        GLStateCache::Counters naive;
+        unsigned int program = 0xFFFFFFFFu;
+        for (const std::pair<uint64_t, unsigned int> &entry : order)
+        {
+            const DrawItem &item = items[entry.second];
+            if (item.shader->ID != program)
+            {
+                naive.programs++;
+                program = item.shader->ID;
+            }
+            naive.textures += item.mesh->textures.size();
+            naive.vertexArrays += 2;
+            naive.draws++;
+        }
+        stats.naive = naive;
+    }
+};
+#endif
@@ -4,11 +4,28 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <common.h>
+
+// binding points of the uniform blocks shared by all programs (see FrameUniforms)
+enum UniformBlockBinding {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHTS_BLOCK_BINDING = 1
+};
+
+// pre-resolved uniform of a shader, obtained once with Shader::GetUniform and passed to Shader::set
+template <typename T>
+struct Uniform {
+    int slot = -1;
+};
+
 class Shader
 {
 public:
@@ -96,6 +113,9 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
+        bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+        bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -109,66 +129,316 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // resolves a uniform once, the handle stays valid for the lifetime of the shader.
+    // uniforms that aren't active in the program give a handle that is silently ignored.
+    template <typename T>
+    Uniform<T> GetUniform(const char *name) const
+    {
+        Uniform<T> uniform;
+        uniform.slot = findSlot(name);
+        return uniform;
+    }
+    // bit mask of the vertex attribute locations the program actually reads (bit n for location n),
+    // a matrix attribute sets the bits of all its columns
+    unsigned int ActiveAttributes() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        unsigned int mask = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(ID, i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+            GLint location = glGetAttribLocation(ID, name.data());
+            // built-ins like gl_VertexID have no location
+            if (location < 0)
+                continue;
+            unsigned int columns = type == GL_FLOAT_MAT4 ? 4 : type == GL_FLOAT_MAT3 ? 3 : type == GL_FLOAT_MAT2 ? 2 : 1;
+            for (unsigned int column = 0; column < columns * size; column++)
+                mask |= 1u << (location + column);
+        }
+        return mask;
+    }
+    // typed uniform setters, values equal to the last uploaded one are skipped
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        int intValue = (int)value;
+        if (changed(uniform.slot, &intValue, sizeof(int)))
+            glUniform1i(uniformSlots[uniform.slot].location, intValue);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        if (changed(uniform.slot, &value, sizeof(int)))
+            glUniform1i(uniformSlots[uniform.slot].location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        if (changed(uniform.slot, &value, sizeof(float)))
+            glUniform1f(uniformSlots[uniform.slot].location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+    {
+        if (changed(uniform.slot, &value[0], 2 * sizeof(float)))
+            glUniform2fv(uniformSlots[uniform.slot].location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+    {
+        if (changed(uniform.slot, &value[0], 3 * sizeof(float)))
+            glUniform3fv(uniformSlots[uniform.slot].location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+    {
+        if (changed(uniform.slot, &value[0], 4 * sizeof(float)))
+            glUniform4fv(uniformSlots[uniform.slot].location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat2> uniform, const glm::mat2 &mat) const
+    {
+        if (changed(uniform.slot, &mat[0][0], 4 * sizeof(float)))
+            glUniformMatrix2fv(uniformSlots[uniform.slot].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const
+    {
+        if (changed(uniform.slot, &mat[0][0], 9 * sizeof(float)))
+            glUniformMatrix3fv(uniformSlots[uniform.slot].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+    {
+        if (changed(uniform.slot, &mat[0][0], 16 * sizeof(float)))
+            glUniformMatrix4fv(uniformSlots[uniform.slot].location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // uniform arrays from their first element on, in one call. Elements past the end of the array are left out,
+    // the values are remembered per element like those of the single setters
+    void setVec2Array(const char *name, const glm::vec2 *values, unsigned int count) const
+    {
+        int slot = findSlot(name);
+        if (slot >= 0 && (count = arrayCount(slot, count)) > 0 && arrayChanged(slot, &values[0][0], 2, count))
+            glUniform2fv(uniformSlots[slot].location, (GLsizei)count, &values[0][0]);
+    }
+    void setVec4Array(const char *name, const glm::vec4 *values, unsigned int count) const
+    {
+        int slot = findSlot(name);
+        if (slot >= 0 && (count = arrayCount(slot, count)) > 0 && arrayChanged(slot, &values[0][0], 4, count))
+            glUniform4fv(uniformSlots[slot].location, (GLsizei)count, &values[0][0]);
+    }
+    // utility uniform functions, looked up by name in the reflected uniform table (no GL query)
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char *name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        set(GetUniform<bool>(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        set(GetUniform<int>(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        set(GetUniform<float>(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char *name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(GetUniform<glm::vec2>(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char *name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        set(GetUniform<glm::vec2>(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char *name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(GetUniform<glm::vec3>(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char *name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        set(GetUniform<glm::vec3>(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char *name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(GetUniform<glm::vec4>(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(const char *name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        set(GetUniform<glm::vec4>(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(GetUniform<glm::mat2>(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(GetUniform<glm::mat3>(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(GetUniform<glm::mat4>(name), mat);
     }
+    // std::string overloads of the above
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const { setBool(name.c_str(), value); }
+    void setInt(const std::string &name, int value) const { setInt(name.c_str(), value); }
+    void setFloat(const std::string &name, float value) const { setFloat(name.c_str(), value); }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(name.c_str(), value); }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(name.c_str(), value); }
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(name.c_str(), value); }
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(name.c_str(), mat); }
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(name.c_str(), mat); }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(name.c_str(), mat); }
 
 private:
+    // active uniform of the program, or one element of an active array, together with the last value uploaded to it.
+    // The elements of an array are consecutive slots
+    struct UniformSlot {
+        GLint location;
+        // elements from this one to the end of its array
+        GLint arrayRemaining;
+        bool hasValue;
+        float value[16];
+    };
+    // a name a slot is found by: "name" and "name[0]" for the first element of an array, "name[k]" for the others
+    struct UniformName {
+        uint32_t hash;
+        std::string name;
+        int slot;
+    };
+    mutable std::vector<UniformSlot> uniformSlots;
+    std::vector<UniformName> uniformNames;
+    // open addressing hash table of indices into uniformNames, -1 marks an empty bucket
+    std::vector<int> uniformTable;
+
+    static uint32_t hashName(const char *name)
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name; name++)
+        {
+            hash ^= (unsigned char)*name;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // queries all active uniforms once after linking
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+            GLint location = glGetUniformLocation(ID, name.data());
+            // uniforms inside uniform blocks have no location
+            if (location < 0)
+                continue;
+            // arrays are reported once as "name[0]" with their size, every element gets a slot of its own
+            char *bracket = strstr(name.data(), "[0]");
+            if (bracket == nullptr || bracket[3] != '\0')
+            {
+                addName(name.data(), addSlot(location, 1));
+                continue;
+            }
+            *bracket = '\0';
+            const std::string base = name.data();
+            int first = addSlot(location, size);
+            addName(base, first);
+            addName(base + "[0]", first);
+            for (GLint element = 1; element < size; element++)
+            {
+                const std::string elementName = base + "[" + std::to_string(element) + "]";
+                addName(elementName, addSlot(glGetUniformLocation(ID, elementName.c_str()), size - element));
+            }
+        }
+
+        size_t capacity = 16;
+        while (capacity < uniformNames.size() * 2)
+            capacity *= 2;
+        uniformTable.assign(capacity, -1);
+        for (size_t i = 0; i < uniformNames.size(); i++)
+        {
+            size_t bucket = uniformNames[i].hash & (capacity - 1);
+            while (uniformTable[bucket] != -1)
+                bucket = (bucket + 1) & (capacity - 1);
+            uniformTable[bucket] = (int)i;
+        }
+    }
+
+    // connects a uniform block to its shared binding point, if the program uses it
+    void bindUniformBlock(const char *blockName, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    int addSlot(GLint location, GLint arrayRemaining)
+    {
+        UniformSlot slot;
+        slot.location = location;
+        slot.arrayRemaining = arrayRemaining;
+        slot.hasValue = false;
+        uniformSlots.push_back(slot);
+        return (int)uniformSlots.size() - 1;
+    }
+
+    void addName(const std::string &name, int slot)
+    {
+        uniformNames.push_back(UniformName{hashName(name.c_str()), name, slot});
+    }
+
+    int findSlot(const char *name) const
+    {
+        if (uniformTable.empty())
+            return -1;
+        uint32_t hash = hashName(name);
+        size_t mask = uniformTable.size() - 1;
+        for (size_t bucket = hash & mask; uniformTable[bucket] != -1; bucket = (bucket + 1) & mask)
+        {
+            const UniformName &entry = uniformNames[uniformTable[bucket]];
+            if (entry.hash == hash && entry.name == name)
+                return entry.slot;
+        }
+        return -1;
+    }
+
+    // remembers the value of a slot, returns false if it is unknown or already holds these bytes
+    bool changed(int slot, const void *data, size_t size) const
+    {
+        if (slot < 0)
+            return false;
+        UniformSlot &uniform = uniformSlots[slot];
+        if (uniform.hasValue && memcmp(uniform.value, data, size) == 0)
+            return false;
+        memcpy(uniform.value, data, size);
+        uniform.hasValue = true;
+        return true;
+    }
+
+    unsigned int arrayCount(int slot, unsigned int count) const
+    {
+        return std::min(count, (unsigned int)uniformSlots[slot].arrayRemaining);
+    }
+
+    // changed for count consecutive elements of floats floats each, true if any of them changed
+    bool arrayChanged(int slot, const float *values, unsigned int floats, unsigned int count) const
+    {
+        bool any = false;
+        for (unsigned int element = 0; element < count; element++)
+            any = changed(slot + (int)element, values + element * floats, floats * sizeof(float)) || any;
+        return any;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
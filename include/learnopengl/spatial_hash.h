@@ -0,0 +1,173 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Uniform grid over unbounded space, its cells hashed into a table of about twice as many buckets as there are
+// cells or points, whichever is less (Teschner et al. 2003). Build sorts the points by bucket with a counting sort, so a bucket's points are
+// contiguous and their positions are copied next to each other. Queries visit the buckets of the cells around
+// the query sphere and test the distances, points of other cells that share a bucket are rejected by that test.
+// With the cell size at least the query radius, a query reads at most 27 cells however many points there are.
+class SpatialHash
+{
+public:
+    explicit SpatialHash(float cellSize = 1.0f) : cellSize(cellSize), inverseCellSize(1.0f / cellSize)
+    {
+    }
+
+    void SetCellSize(float size)
+    {
+        cellSize = size;
+        inverseCellSize = 1.0f / size;
+    }
+
+    float CellSize() const
+    {
+        return cellSize;
+    }
+
+    // indexes count points, queries return their indices in these arrays
+    void Build(const float *x, const float *y, const float *z, unsigned int count)
+    {
+        // about two buckets per cell that can hold points, so a dense swarm in few cells has a small table
+        // that stays in cache while the points are counted and scattered
+        glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+        for (unsigned int i = 0; i < count; i++)
+        {
+            low = glm::min(low, glm::vec3(x[i], y[i], z[i]));
+            high = glm::max(high, glm::vec3(x[i], y[i], z[i]));
+        }
+        double cells = count > 0 ? (double)(cell(high.x) - cell(low.x) + 1) * (cell(high.y) - cell(low.y) + 1) *
+                                       (cell(high.z) - cell(low.z) + 1)
+                                 : 0.0;
+        unsigned int buckets = 64;
+        while (buckets < 2 * count && buckets < 2 * cells)
+            buckets *= 2;
+        bucketMask = buckets - 1;
+        bucketStart.assign(buckets + 1, 0);
+        pointBuckets.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            pointBuckets[i] = bucket(cell(x[i]), cell(y[i]), cell(z[i]));
+            bucketStart[pointBuckets[i] + 1]++;
+        }
+        for (unsigned int b = 0; b < buckets; b++)
+            bucketStart[b + 1] += bucketStart[b];
+        // bucketStart[b] is used as the fill position of bucket b and ends up at the start of bucket b + 1,
+        // shifting back afterwards restores the starts
+        indices.resize(count);
+        positions.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            unsigned int slot = bucketStart[pointBuckets[i]]++;
+            indices[slot] = i;
+            positions[slot] = glm::vec3(x[i], y[i], z[i]);
+        }
+        for (unsigned int b = buckets; b > 0; b--)
+            bucketStart[b] = bucketStart[b - 1];
+        bucketStart[0] = 0;
+    }
+
+    // appends the indices of the points closer than radius to point, in no particular order
+    void QueryRadius(const glm::vec3 &point, float radius, std::vector<unsigned int> &result) const
+    {
+        const float radiusSquared = radius * radius;
+        forEachBucket(point, radius, [&](unsigned int b) {
+            for (unsigned int slot = bucketStart[b]; slot < bucketStart[b + 1]; slot++)
+            {
+                glm::vec3 d = positions[slot] - point;
+                if (glm::dot(d, d) < radiusSquared)
+                    result.push_back(indices[slot]);
+            }
+        });
+    }
+
+    // the point nearest to point that is at least minDistance and less than maxDistance away, -1 if there is none.
+    // On equal distances the lowest index, like a linear scan
+    int Nearest(const glm::vec3 &point, float minDistance, float maxDistance, float &distance) const
+    {
+        const float minSquared = minDistance * minDistance;
+        float nearestSquared = maxDistance * maxDistance;
+        int nearest = -1;
+        forEachBucket(point, maxDistance, [&](unsigned int b) {
+            for (unsigned int slot = bucketStart[b]; slot < bucketStart[b + 1]; slot++)
+            {
+                glm::vec3 d = positions[slot] - point;
+                float squared = glm::dot(d, d);
+                if (squared < minSquared)
+                    continue;
+                if (squared < nearestSquared || (squared == nearestSquared && nearest >= 0 && (int)indices[slot] < nearest))
+                {
+                    nearestSquared = squared;
+                    nearest = (int)indices[slot];
+                }
+            }
+        });
+        distance = nearest >= 0 ? std::sqrt(nearestSquared) : std::numeric_limits<float>::max();
+        return nearest;
+    }
+
+private:
+    // cells a query sphere no larger than a cell can touch
+    static const unsigned int MAX_NEARBY_CELLS = 27;
+
+    float cellSize;
+    float inverseCellSize;
+    unsigned int bucketMask = 0;
+    // bucketStart[b] to bucketStart[b + 1] are the slots of bucket b
+    std::vector<unsigned int> bucketStart;
+    std::vector<unsigned int> pointBuckets;
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions;
+
+    int cell(float coordinate) const
+    {
+        return (int)std::floor(coordinate * inverseCellSize);
+    }
+
+    unsigned int bucket(int x, int y, int z) const
+    {
+        return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u)) & bucketMask;
+    }
+
+    // calls visit once for every bucket of the cells the sphere touches
+    template <typename Visit>
+    void forEachBucket(const glm::vec3 &point, float radius, Visit visit) const
+    {
+        if (indices.empty())
+            return;
+        const int minX = cell(point.x - radius), maxX = cell(point.x + radius);
+        const int minY = cell(point.y - radius), maxY = cell(point.y + radius);
+        const int minZ = cell(point.z - radius), maxZ = cell(point.z + radius);
+        // cells of the sphere can share a bucket, visiting it twice would report its points twice. With the radius
+        // at most the cell size the sphere spans at most 3 cells per axis and the buckets seen fit on the stack,
+        // larger spheres use a buffer kept per thread, so queries don't allocate
+        const size_t cells = (size_t)(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+        unsigned int nearbyVisited[MAX_NEARBY_CELLS];
+        static thread_local std::vector<unsigned int> farVisited;
+        unsigned int *visited = nearbyVisited;
+        if (cells > MAX_NEARBY_CELLS)
+        {
+            farVisited.resize(cells);
+            visited = farVisited.data();
+        }
+        unsigned int visitedCount = 0;
+        for (int x = minX; x <= maxX; x++)
+            for (int y = minY; y <= maxY; y++)
+                for (int z = minZ; z <= maxZ; z++)
+                {
+                    unsigned int b = bucket(x, y, z);
+                    if (std::find(visited, visited + visitedCount, b) != visited + visitedCount)
+                        continue;
+                    visited[visitedCount++] = b;
+                    visit(b);
+                }
+    }
+};
+#endif
@@ -0,0 +1,115 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <string>
+#include <utility>
+
+// decoded image as returned by stb_image, owns its pixels
+struct ImageData {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    ImageData() {}
+    ImageData(const ImageData &) = delete;
+    ImageData &operator=(const ImageData &) = delete;
+    ImageData(ImageData &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+    ImageData &operator=(ImageData &&other) noexcept
+    {
+        std::swap(pixels, other.pixels);
+        std::swap(width, other.width);
+        std::swap(height, other.height);
+        std::swap(components, other.components);
+        return *this;
+    }
+    ~ImageData()
+    {
+        if (pixels)
+            stbi_image_free(pixels);
+    }
+};
+
+// decodes an image file, safe to call from worker threads (no GL calls)
+inline ImageData DecodeImage(const std::string &path)
+{
+    ImageData image;
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+inline GLenum ImageFormat(int components)
+{
+    if (components == 1)
+        return GL_RED;
+    else if (components == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+// uploads a decoded image into an existing texture object and builds its mipmaps.
+// clampAlpha: use GL_CLAMP_TO_EDGE for RGBA images to prevent semi-transparent borders.
+inline void UploadTexture2D(unsigned int textureID, const ImageData &image, bool clampAlpha)
+{
+    GLenum format = ImageFormat(image.components);
+    GLint wrap = (clampAlpha && format == GL_RGBA) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// creates a 1x1 texture of the given color, shown until the real image has been uploaded
+inline unsigned int CreatePlaceholderTexture(const unsigned char color[4])
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return textureID;
+}
+
+// cubemap with 1x1 faces of the given color, shown until the real faces have been uploaded
+inline unsigned int CreatePlaceholderCubemap(const unsigned char color[4])
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    for (unsigned int i = 0; i < 6; i++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+// uploads six decoded faces into a cubemap, order: +X, -X, +Y, -Y, +Z, -Z
+inline void UploadCubemap(unsigned int textureID, const ImageData faces[6])
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        GLenum format = ImageFormat(faces[i].components);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].width, faces[i].height, 0, format, GL_UNSIGNED_BYTE, faces[i].pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+#endif
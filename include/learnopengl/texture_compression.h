@@ -0,0 +1,547 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/texture.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// EXT_texture_compression_s3tc isn't part of core GL 3.3, so glad doesn't define its formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// mip chain of a block compressed image, level 0 first
+struct CompressedImage {
+    struct Level {
+        int width;
+        int height;
+        std::vector<unsigned char> data;
+    };
+    GLenum format = 0;
+    std::vector<Level> levels;
+
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const Level &level : levels)
+            bytes += level.data.size();
+        return bytes;
+    }
+};
+
+// CPU block compression to BC1 (DXT1, opaque) and BC3 (DXT5, with alpha).
+// Endpoints are the extremes of the block along its principal color axis, which is far from the best
+// possible quality but fast enough to run on the loader threads the first time a texture is seen.
+namespace BlockCompression
+{
+    inline uint16_t packRGB565(const float color[3])
+    {
+        int r = std::min(std::max((int)(color[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+        int g = std::min(std::max((int)(color[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+        int b = std::min(std::max((int)(color[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    inline void unpackRGB565(uint16_t packed, int color[3])
+    {
+        int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+        color[0] = r << 3 | r >> 2;
+        color[1] = g << 2 | g >> 4;
+        color[2] = b << 3 | b >> 2;
+    }
+
+    // 4x4 block of RGBA pixels -> 8 bytes of BC1 color data, always in 4 color mode
+    inline void encodeColorBlock(const unsigned char block[16][4], unsigned char out[8])
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += block[i][c] / 16.0f;
+
+        // principal axis of the colors by power iteration on their covariance
+        float covariance[6] = {0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+            float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length <= 0.0f)
+                break;
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float endpoints[2][3];
+        for (int c = 0; c < 3; c++)
+        {
+            endpoints[0][c] = mean[c] + axis[c] * maxProjection / std::max(axisLengthSquared, 1e-6f);
+            endpoints[1][c] = mean[c] + axis[c] * minProjection / std::max(axisLengthSquared, 1e-6f);
+        }
+        uint16_t color0 = packRGB565(endpoints[0]);
+        uint16_t color1 = packRGB565(endpoints[1]);
+        // color0 > color1 selects the 4 color mode
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                    int distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+        out[0] = (unsigned char)(color0 & 0xFF);
+        out[1] = (unsigned char)(color0 >> 8);
+        out[2] = (unsigned char)(color1 & 0xFF);
+        out[3] = (unsigned char)(color1 >> 8);
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (unsigned char)(indices >> (8 * i) & 0xFF);
+    }
+
+    // 4x4 block of RGBA pixels -> 8 bytes of BC4 style alpha data (as in BC3), in 8 value mode
+    inline void encodeAlphaBlock(const unsigned char block[16][4], unsigned char out[8])
+    {
+        int alpha0 = 0, alpha1 = 255;
+        for (int i = 0; i < 16; i++)
+        {
+            alpha0 = std::max(alpha0, (int)block[i][3]);
+            alpha1 = std::min(alpha1, (int)block[i][3]);
+        }
+        uint64_t indices = 0;
+        if (alpha0 != alpha1)
+        {
+            int palette[8];
+            palette[0] = alpha0;
+            palette[1] = alpha1;
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 1 << 30;
+                for (int p = 0; p < 8; p++)
+                {
+                    int distance = std::abs(block[i][3] - palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+        out[0] = (unsigned char)alpha0;
+        out[1] = (unsigned char)alpha1;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(indices >> (8 * i) & 0xFF);
+    }
+
+    // compresses one RGBA8 level, partial blocks at the edges repeat the last row/column
+    inline void compressLevel(const unsigned char *rgba, int width, int height, bool alpha, std::vector<unsigned char> &out)
+    {
+        const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        const int blockBytes = alpha ? 16 : 8;
+        out.resize((size_t)blocksX * blocksY * blockBytes);
+        unsigned char *dst = out.data();
+        unsigned char block[16][4];
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                for (int y = 0; y < 4; y++)
+                {
+                    int sy = std::min(by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sx = std::min(bx * 4 + x, width - 1);
+                        memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+                    }
+                }
+                if (alpha)
+                {
+                    encodeAlphaBlock(block, dst);
+                    dst += 8;
+                }
+                encodeColorBlock(block, dst);
+                dst += 8;
+            }
+        }
+    }
+
+    // 2x2 box filter, odd sizes repeat the last row/column
+    inline std::vector<unsigned char> downsample(const std::vector<unsigned char> &rgba, int width, int height, int &newWidth, int &newHeight)
+    {
+        newWidth = std::max(width / 2, 1);
+        newHeight = std::max(height / 2, 1);
+        std::vector<unsigned char> result((size_t)newWidth * newHeight * 4);
+        for (int y = 0; y < newHeight; y++)
+        {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < newWidth; x++)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+                              rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                    result[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return result;
+    }
+
+    // BC1 for opaque images, BC3 if any pixel is translucent. Builds the full mip chain.
+    inline CompressedImage Compress(const ImageData &image)
+    {
+        CompressedImage compressed;
+        // expand to RGBA8
+        std::vector<unsigned char> rgba((size_t)image.width * image.height * 4);
+        bool alpha = false;
+        for (size_t i = 0; i < (size_t)image.width * image.height; i++)
+        {
+            const unsigned char *src = image.pixels + i * image.components;
+            unsigned char *dst = rgba.data() + i * 4;
+            if (image.components >= 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+            else
+                dst[0] = dst[1] = dst[2] = src[0];
+            dst[3] = image.components == 4 ? src[3] : image.components == 2 ? src[1] : 255;
+            alpha = alpha || dst[3] != 255;
+        }
+        compressed.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+        int width = image.width, height = image.height;
+        while (true)
+        {
+            CompressedImage::Level level;
+            level.width = width;
+            level.height = height;
+            compressLevel(rgba.data(), width, height, alpha, level.data);
+            compressed.levels.push_back(std::move(level));
+            if (width == 1 && height == 1)
+                break;
+            rgba = downsample(rgba, width, height, width, height);
+        }
+        return compressed;
+    }
+}
+
+// Block compressed textures, transcoded from the JPG/PNG sources the first time they are loaded and kept in
+// a cache next to the source (<source>.texcache) that is valid under the same rules as the mesh cache.
+// Images are stored as stb_image decodes them, after the vertical flip set at startup.
+// Needs EXT_texture_compression_s3tc, without it (or with LOGL_TEXTURE_COMPRESSION=0) textures are
+// uploaded uncompressed as before.
+class TextureCompression
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    // VRAM taken by 2D textures loaded so far, and what they would take uncompressed (RGBA8 with mipmaps,
+    // which is how drivers usually store GL_RGB8 too)
+    static std::atomic<uint64_t> &VramBytes()
+    {
+        static std::atomic<uint64_t> bytes{0};
+        return bytes;
+    }
+    static std::atomic<uint64_t> &UncompressedVramBytes()
+    {
+        static std::atomic<uint64_t> bytes{0};
+        return bytes;
+    }
+
+    // checks for the extension, needs the GL context. Until this is called compression is off.
+    static void Init()
+    {
+        bool supported = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && !supported; i++)
+            supported = strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0;
+        const char *env = getenv("LOGL_TEXTURE_COMPRESSION");
+        bool disabled = env != nullptr && strcmp(env, "0") == 0;
+        if (!supported)
+            std::cout << "TEXTURE_COMPRESSION:: GL_EXT_texture_compression_s3tc not supported, textures are uploaded uncompressed" << std::endl;
+        enabled() = supported && !disabled;
+    }
+
+    static bool Enabled()
+    {
+        return enabled();
+    }
+
+    static std::string PathFor(const std::string &sourcePath)
+    {
+        return sourcePath + ".texcache";
+    }
+
+    // compressed mip chain of an image file, from the cache or transcoded (and then cached).
+    // Returns false if the source can't be decoded. CPU only, runs on loader threads.
+    static bool Load(const std::string &sourcePath, CompressedImage &image)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (loadCache(sourcePath, image))
+            return true;
+
+        ImageData decoded = DecodeImage(sourcePath);
+        if (!decoded.pixels)
+            return false;
+        image = BlockCompression::Compress(decoded);
+        double transcodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "TEXTURE_COMPRESSION:: transcoded " << sourcePath << " (" << decoded.width << "x" << decoded.height << ") in "
+                  << transcodeMs << " ms" << std::endl;
+        storeCache(sourcePath, image);
+        return true;
+    }
+
+private:
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint32_t levelCount;
+        uint32_t padding;
+        uint64_t sourceSize;
+        int64_t  sourceMTime;
+        uint64_t sourceHash;
+    };
+
+    struct LevelEntry {
+        uint32_t width;
+        uint32_t height;
+        uint64_t size;
+    };
+
+    static bool &enabled()
+    {
+        static bool value = false;
+        return value;
+    }
+
+    // 7 characters plus the terminator fill Header::magic
+    static const char *magic()
+    {
+        return "LOGLTEX";
+    }
+
+    static bool loadCache(const std::string &sourcePath, CompressedImage &image)
+    {
+        struct stat source;
+        if (stat(sourcePath.c_str(), &source) != 0)
+            return false;
+        MappedFile file;
+        if (!file.open(PathFor(sourcePath)) || file.size < sizeof(Header))
+            return false;
+
+        Header header;
+        memcpy(&header, file.data, sizeof(Header));
+        if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != VERSION ||
+            header.sourceSize != (uint64_t)source.st_size || header.levelCount == 0 || header.levelCount > 32)
+            return false;
+        if (header.sourceMTime != FileModificationTime(source))
+        {
+            uint64_t hash;
+            if (!HashFile(sourcePath, hash) || hash != header.sourceHash)
+                return false;
+        }
+
+        uint64_t offset = sizeof(Header) + (uint64_t)header.levelCount * sizeof(LevelEntry);
+        if (offset > file.size)
+            return false;
+        image.format = header.format;
+        image.levels.resize(header.levelCount);
+        for (uint32_t i = 0; i < header.levelCount; i++)
+        {
+            LevelEntry entry;
+            memcpy(&entry, file.data + sizeof(Header) + i * sizeof(LevelEntry), sizeof(LevelEntry));
+            if (entry.size > file.size - offset)
+                return false;
+            image.levels[i].width = (int)entry.width;
+            image.levels[i].height = (int)entry.height;
+            image.levels[i].data.assign(file.data + offset, file.data + offset + entry.size);
+            offset += entry.size;
+        }
+        return true;
+    }
+
+    // written to a temporary file and renamed, like the mesh cache
+    static bool storeCache(const std::string &sourcePath, const CompressedImage &image)
+    {
+        struct stat source;
+        uint64_t hash;
+        if (stat(sourcePath.c_str(), &source) != 0 || !HashFile(sourcePath, hash))
+            return false;
+
+        Header header;
+        memset(&header, 0, sizeof(Header));
+        memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version = VERSION;
+        header.format = image.format;
+        header.levelCount = (uint32_t)image.levels.size();
+        header.sourceSize = (uint64_t)source.st_size;
+        header.sourceMTime = FileModificationTime(source);
+        header.sourceHash = hash;
+
+        const std::string cachePath = PathFor(sourcePath);
+        const std::string tempPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                std::cout << "ERROR::TEXTURE_COMPRESSION:: could not write " << tempPath << std::endl;
+                return false;
+            }
+            out.write((const char *)&header, sizeof(Header));
+            for (const CompressedImage::Level &level : image.levels)
+            {
+                LevelEntry entry = {(uint32_t)level.width, (uint32_t)level.height, (uint64_t)level.data.size()};
+                out.write((const char *)&entry, sizeof(LevelEntry));
+            }
+            for (const CompressedImage::Level &level : image.levels)
+                out.write((const char *)level.data.data(), level.data.size());
+            if (!out)
+            {
+                std::cout << "ERROR::TEXTURE_COMPRESSION:: could not write " << tempPath << std::endl;
+                out.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    }
+};
+
+// uploads a compressed mip chain into an existing texture object, nothing is generated at runtime
+inline void UploadCompressedTexture2D(unsigned int textureID, const CompressedImage &image, bool clampAlpha)
+{
+    GLint wrap = (clampAlpha && image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for (size_t i = 0; i < image.levels.size(); i++)
+    {
+        const CompressedImage::Level &level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, image.format, level.width, level.height, 0, (GLsizei)level.data.size(),
+                               level.data.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    const CompressedImage::Level &base = image.levels[0];
+    TextureCompression::VramBytes() += image.Bytes();
+    TextureCompression::UncompressedVramBytes() += (uint64_t)base.width * base.height * 4 * 4 / 3;
+}
+
+// a 2D texture ready for upload: compressed if compression is enabled, decoded otherwise.
+// Prepared on loader threads, uploaded on the GL thread.
+struct PreparedTexture {
+    CompressedImage compressed;
+    ImageData image;
+    double cpuMs = 0.0;
+
+    bool Valid() const
+    {
+        return !compressed.levels.empty() || image.pixels != nullptr;
+    }
+};
+
+inline PreparedTexture PrepareTexture2D(const std::string &path)
+{
+    auto start = std::chrono::steady_clock::now();
+    PreparedTexture prepared;
+    if (!TextureCompression::Enabled() || !TextureCompression::Load(path, prepared.compressed))
+    {
+        prepared.compressed.levels.clear();
+        prepared.image = DecodeImage(path);
+    }
+    prepared.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return prepared;
+}
+
+// uploads a prepared texture, and logs how long it took and what it costs in VRAM
+inline void UploadPreparedTexture2D(unsigned int textureID, const PreparedTexture &prepared, const std::string &path, bool clampAlpha)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t vramBefore = TextureCompression::VramBytes();
+    if (!prepared.compressed.levels.empty())
+        UploadCompressedTexture2D(textureID, prepared.compressed, clampAlpha);
+    else
+    {
+        UploadTexture2D(textureID, prepared.image, clampAlpha);
+        uint64_t bytes = (uint64_t)prepared.image.width * prepared.image.height * 4 * 4 / 3;
+        TextureCompression::VramBytes() += bytes;
+        TextureCompression::UncompressedVramBytes() += bytes;
+    }
+    double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "TEXTURE::LOAD:: " << path << (prepared.compressed.levels.empty() ? " uncompressed" : " compressed")
+              << ", cpu " << prepared.cpuMs << " ms, upload " << uploadMs << " ms, "
+              << (TextureCompression::VramBytes() - vramBefore) / 1024 << " KiB" << std::endl;
+}
+#endif
@@ -0,0 +1,176 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh_cache.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+// Process wide registry of the GL textures loaded from files, shared by all models and the scene.
+// A texture is found by its canonical path, or by the hash of its contents so that identical files under
+// different names are only decoded and uploaded once. Textures are reference counted and the registry
+// deletes them when the last reference is released.
+// The variant tells apart textures of the same file that are uploaded differently (wrap mode, cubemap faces).
+// Only used on the GL thread, content hashes are computed by the callers (usually on loader threads).
+class TextureRegistry
+{
+public:
+    struct Stats {
+        unsigned int textures = 0;
+        unsigned int requests = 0;
+        unsigned int pathHits = 0;
+        unsigned int contentHits = 0;
+    };
+
+    static TextureRegistry &Instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // the absolute path without symbolic links and ./.. components, or path as it is if it doesn't exist
+    static std::string CanonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved) == nullptr)
+            return path;
+        return std::string(resolved);
+    }
+
+    // content hash of a texture file, 0 if it can't be read. Reads the whole file, so call it off the GL thread.
+    static uint64_t ContentHash(const std::string &path)
+    {
+        uint64_t hash = 0;
+        if (!HashFile(path, hash))
+            return 0;
+        return hash;
+    }
+
+    // id of an already registered texture with this path or content (contentHash 0 if unknown), with a
+    // reference added. 0 if there is none, the caller then loads it and calls Register.
+    unsigned int Acquire(const std::string &canonicalPath, uint64_t contentHash, const std::string &variant = "")
+    {
+        stats.requests++;
+        auto path = byPath.find(pathKey(canonicalPath, variant));
+        if (path != byPath.end())
+        {
+            stats.pathHits++;
+            entries[path->second].references++;
+            return path->second;
+        }
+        if (contentHash != 0)
+        {
+            auto content = byContent.find(contentKey(contentHash, variant));
+            if (content != byContent.end())
+            {
+                std::cout << "TEXTURE_REGISTRY:: " << canonicalPath << " has the same contents as " << entries[content->second].path
+                          << ", sharing texture " << content->second << std::endl;
+                stats.contentHits++;
+                // later requests for this path are found by path
+                byPath[pathKey(canonicalPath, variant)] = content->second;
+                entries[content->second].references++;
+                return content->second;
+            }
+        }
+        return 0;
+    }
+
+    // adds a texture the caller just created, with one reference held by the caller
+    void Register(unsigned int textureID, const std::string &canonicalPath, uint64_t contentHash, const std::string &variant = "")
+    {
+        Entry &entry = entries[textureID];
+        entry.path = canonicalPath;
+        entry.variant = variant;
+        entry.references = 1;
+        byPath[pathKey(canonicalPath, variant)] = textureID;
+        SetContentHash(textureID, contentHash);
+        stats.textures = (unsigned int)entries.size();
+    }
+
+    // content hash of a registered texture that wasn't known when it was registered
+    void SetContentHash(unsigned int textureID, uint64_t contentHash)
+    {
+        auto entry = entries.find(textureID);
+        if (contentHash == 0 || entry == entries.end() || entry->second.contentHash != 0)
+            return;
+        entry->second.contentHash = contentHash;
+        // the first texture with some content stays the one others are matched against
+        byContent.emplace(contentKey(contentHash, entry->second.variant), textureID);
+    }
+
+    bool Contains(unsigned int textureID) const
+    {
+        return entries.count(textureID) != 0;
+    }
+
+    // drops a reference, deleting the texture with the last one
+    void Release(unsigned int textureID)
+    {
+        auto entry = entries.find(textureID);
+        if (entry == entries.end() || --entry->second.references > 0)
+            return;
+        forget(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+
+    // deletes all textures regardless of their references, needs the GL context
+    void Clear()
+    {
+        for (auto &entry : entries)
+            glDeleteTextures(1, &entry.first);
+        entries.clear();
+        byPath.clear();
+        byContent.clear();
+        stats.textures = 0;
+    }
+
+    const Stats &GetStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::string path;
+        std::string variant;
+        uint64_t contentHash = 0;
+        unsigned int references = 0;
+    };
+
+    std::unordered_map<unsigned int, Entry> entries;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    Stats stats;
+
+    TextureRegistry() {}
+    TextureRegistry(const TextureRegistry &) = delete;
+    TextureRegistry &operator=(const TextureRegistry &) = delete;
+
+    static std::string pathKey(const std::string &canonicalPath, const std::string &variant)
+    {
+        return variant.empty() ? canonicalPath : canonicalPath + '|' + variant;
+    }
+
+    static uint64_t contentKey(uint64_t contentHash, const std::string &variant)
+    {
+        return variant.empty() ? contentHash : HashBytes((const unsigned char *)variant.data(), variant.size(), contentHash);
+    }
+
+    void forget(unsigned int textureID)
+    {
+        for (auto path = byPath.begin(); path != byPath.end();)
+            path = path->second == textureID ? byPath.erase(path) : std::next(path);
+        for (auto content = byContent.begin(); content != byContent.end();)
+            content = content->second == textureID ? byContent.erase(content) : std::next(content);
+        entries.erase(textureID);
+        stats.textures = (unsigned int)entries.size();
+    }
+};
+#endif
@@ -0,0 +1,157 @@
+#ifndef TRANSPARENT_BATCH_H
+#define TRANSPARENT_BATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// working arrays of RadixSortDescending, kept between calls so sorting every frame doesn't allocate
+struct RadixSortScratch {
+    std::vector<uint32_t> bits;
+    std::vector<uint32_t> bitsScratch;
+    std::vector<unsigned int> orderScratch;
+};
+
+// sorts indices by their keys from the largest key to the smallest (back to front for view depths).
+// LSD radix sort over the bits of the floats, 8 bits per pass, stable. Passes in which all keys share
+// their byte are skipped, so keys that only differ in their high bits cost fewer passes.
+inline void RadixSortDescending(const std::vector<float> &keys, std::vector<unsigned int> &order, RadixSortScratch &scratch)
+{
+    const size_t count = keys.size();
+    std::vector<uint32_t> &bits = scratch.bits, &bitsScratch = scratch.bitsScratch;
+    std::vector<unsigned int> &orderScratch = scratch.orderScratch;
+    bits.resize(count);
+    bitsScratch.resize(count);
+    orderScratch.resize(count);
+    order.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t value;
+        memcpy(&value, &keys[i], sizeof(value));
+        // order preserving map of the floats to unsigned ints: flip all bits of negative numbers, the sign of the others
+        value = (value & 0x80000000u) ? ~value : value | 0x80000000u;
+        // inverted, so ascending order of the ints is descending order of the floats
+        bits[i] = ~value;
+        order[i] = (unsigned int)i;
+    }
+
+    for (unsigned int shift = 0; shift < 32; shift += 8)
+    {
+        size_t histogram[256] = {0};
+        for (size_t i = 0; i < count; i++)
+            histogram[(bits[i] >> shift) & 0xFF]++;
+        if (count == 0 || histogram[(bits[0] >> shift) & 0xFF] == count)
+            continue;
+        size_t offset = 0;
+        for (size_t &bucket : histogram)
+        {
+            size_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t destination = histogram[(bits[i] >> shift) & 0xFF]++;
+            bitsScratch[destination] = bits[i];
+            orderScratch[destination] = order[i];
+        }
+        bits.swap(bitsScratch);
+        order.swap(orderScratch);
+    }
+}
+
+// Draws many copies of one blended quad mesh in a single instanced call, sorted back to front every frame
+// unless the blending doesn't depend on the order.
+// The mesh is the interleaved position (3 floats) and texture coordinate (2 floats) layout of the quads in main;
+// the per-instance model matrix goes to locations 2 to 5.
+class TransparentBatch
+{
+public:
+    // statistics of the last Draw
+    unsigned int instances = 0;
+    double sortMs = 0.0;
+
+    // shares vertexBuffer with the caller, vertexCount vertices are drawn per instance
+    void Init(unsigned int vertexBuffer, unsigned int vertexCount)
+    {
+        this->vertexCount = vertexCount;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &instanceBuffer);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(2 + i, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void Destroy()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &instanceBuffer);
+        VAO = instanceBuffer = 0;
+    }
+
+    // queues an instance, depth is its distance from the camera
+    void Add(const glm::mat4 &transform, float depth)
+    {
+        transforms.push_back(transform);
+        depths.push_back(depth);
+    }
+
+    // sorts the queued instances back to front and draws them, the shader and textures have to be bound.
+    // Order independent blending (see WeightedBlendedOIT) doesn't need the sort, backToFront false skips it.
+    void Draw(bool backToFront = true)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (backToFront)
+        {
+            RadixSortDescending(depths, order, sortScratch);
+            sorted.resize(order.size());
+            for (size_t i = 0; i < order.size(); i++)
+                sorted[i] = transforms[order[i]];
+        }
+        else
+            sorted.swap(transforms);
+        sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        instances = (unsigned int)sorted.size();
+
+        if (!sorted.empty())
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            // orphaned every frame, like the model instance buffers
+            glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(glm::mat4), sorted.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(VAO);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, (GLsizei)sorted.size());
+            glBindVertexArray(0);
+        }
+        transforms.clear();
+        depths.clear();
+    }
+
+private:
+    unsigned int VAO = 0;
+    unsigned int instanceBuffer = 0;
+    unsigned int vertexCount = 0;
+    std::vector<glm::mat4> transforms;
+    std::vector<float> depths;
+    std::vector<unsigned int> order;
+    RadixSortScratch sortScratch;
+    std::vector<glm::mat4> sorted;
+};
+#endif
@@ -0,0 +1,196 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// float to IEEE half, rounded to nearest. Values out of range saturate to infinity, tiny ones flush to zero.
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if (exponent <= 0)
+        return sign;
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7C00);
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    // round to nearest, a carry into the exponent is still the correct result
+    half += (mantissa >> 12) & 1;
+    return (uint16_t)(sign | std::min(half, 0x7C00u));
+}
+
+// packs a vector with components in [-1, 1] and a sign w into GL_INT_2_10_10_10_REV (signed normalized)
+inline uint32_t PackSnorm1010102(const glm::vec3 &v, float w)
+{
+    auto component = [](float c, float scale, uint32_t mask) {
+        int value = (int)std::lround(std::min(std::max(c, -1.0f), 1.0f) * scale);
+        return (uint32_t)value & mask;
+    };
+    return component(v.x, 511.0f, 0x3FF) | component(v.y, 511.0f, 0x3FF) << 10 | component(v.z, 511.0f, 0x3FF) << 20 |
+           component(w, 1.0f, 0x3) << 30;
+}
+
+// The attribute streams a vertex buffer carries and how they are stored on the GPU.
+// The packed layout stores positions as floats, normals and tangents as 10_10_10_2 and texture coordinates
+// as half floats. It has no bitangent stream, the tangent carries the handedness in w instead:
+//     bitangent = cross(normal, tangent.xyz) * tangent.w
+// The full layout is the 56 byte Vertex struct as it is, for shaders that need exact values.
+// Locations match Vertex: 0 position, 1 normal, 2 texture coordinates, 3 tangent, 4 bitangent (full only).
+struct VertexLayout
+{
+    enum Streams {
+        NORMAL = 1 << 1,
+        TEXCOORDS = 1 << 2,
+        TANGENT = 1 << 3,
+        BITANGENT = 1 << 4
+    };
+
+    // which of the optional streams are stored, the position is always there
+    unsigned int streams = NORMAL | TEXCOORDS;
+    bool packed = true;
+
+    static VertexLayout Full()
+    {
+        VertexLayout layout;
+        layout.streams = NORMAL | TEXCOORDS | TANGENT | BITANGENT;
+        layout.packed = false;
+        return layout;
+    }
+
+    // the packed layout with only the streams shaders read. A bitangent input is served by the tangent,
+    // shaders reading location 4 should use the full layout instead.
+    static VertexLayout ForShaders(std::initializer_list<const Shader *> shaders)
+    {
+        unsigned int active = 0;
+        for (const Shader *shader : shaders)
+            active |= shader->ActiveAttributes();
+        VertexLayout layout;
+        layout.streams = active & (NORMAL | TEXCOORDS | TANGENT);
+        if (active & BITANGENT)
+            layout.streams |= TANGENT;
+        return layout;
+    }
+
+    unsigned int Stride() const
+    {
+        if (!packed)
+            return sizeof(Vertex);
+        unsigned int stride = 3 * sizeof(float);
+        if (streams & NORMAL)
+            stride += sizeof(uint32_t);
+        if (streams & TEXCOORDS)
+            stride += 2 * sizeof(uint16_t);
+        if (streams & TANGENT)
+            stride += sizeof(uint32_t);
+        return stride;
+    }
+
+    // converts vertices to this layout, appending Stride() bytes per vertex to out
+    void Pack(const vector<Vertex> &vertices, std::vector<unsigned char> &out) const
+    {
+        size_t start = out.size();
+        out.resize(start + vertices.size() * Stride());
+        unsigned char *dst = out.data() + start;
+        if (!packed)
+        {
+            memcpy(dst, vertices.data(), vertices.size() * sizeof(Vertex));
+            return;
+        }
+        for (const Vertex &vertex : vertices)
+        {
+            memcpy(dst, &vertex.Position, 3 * sizeof(float));
+            dst += 3 * sizeof(float);
+            if (streams & NORMAL)
+            {
+                uint32_t normal = PackSnorm1010102(safeNormalize(vertex.Normal), 0.0f);
+                memcpy(dst, &normal, sizeof(normal));
+                dst += sizeof(normal);
+            }
+            if (streams & TEXCOORDS)
+            {
+                uint16_t uv[2] = {FloatToHalf(vertex.TexCoords.x), FloatToHalf(vertex.TexCoords.y)};
+                memcpy(dst, uv, sizeof(uv));
+                dst += sizeof(uv);
+            }
+            if (streams & TANGENT)
+            {
+                // handedness of the tangent frame, so the bitangent can be rebuilt in the shader
+                float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                uint32_t tangent = PackSnorm1010102(safeNormalize(vertex.Tangent), handedness);
+                memcpy(dst, &tangent, sizeof(tangent));
+                dst += sizeof(tangent);
+            }
+        }
+    }
+
+    // points the attributes at a buffer in this layout, expects the VAO and GL_ARRAY_BUFFER to be bound
+    void Setup() const
+    {
+        if (!packed)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+            return;
+        }
+
+        GLsizei stride = Stride();
+        size_t offset = 0;
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += 3 * sizeof(float);
+        if (streams & NORMAL)
+        {
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+            offset += sizeof(uint32_t);
+        }
+        if (streams & TEXCOORDS)
+        {
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+            offset += 2 * sizeof(uint16_t);
+        }
+        if (streams & TANGENT)
+        {
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+            offset += sizeof(uint32_t);
+        }
+    }
+
+private:
+    static glm::vec3 safeNormalize(const glm::vec3 &v)
+    {
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+};
+#endif
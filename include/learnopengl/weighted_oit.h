@@ -0,0 +1,128 @@
+#ifndef WEIGHTED_OIT_H
+#define WEIGHTED_OIT_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <iostream>
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013). Transparent surfaces are
+// drawn in any order into two off screen targets:
+//   accumulation (RGBA16F): rgb is the sum of color * alpha * weight, a is the revealage, the product of (1 - alpha)
+//   alpha weight (R16F): the sum of alpha * weight
+// and Composite blends their weighted average over the default framebuffer. GL 3.3 has no blend function per
+// draw buffer, so both targets share glBlendFuncSeparate(ONE, ONE, ZERO, ONE_MINUS_SRC_ALPHA): colors add up,
+// alphas multiply, which is why the revealage lives in the alpha of the first target.
+// The opaque depth is copied in so transparent fragments behind opaque ones are still rejected. Needs the GL context.
+class WeightedBlendedOIT
+{
+public:
+    void Init(int width, int height)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &accumulation);
+        glGenTextures(1, &alphaWeight);
+        glGenRenderbuffers(1, &depth);
+        // the composite triangle is made in its vertex shader, but core profile draws need a bound VAO
+        glGenVertexArrays(1, &emptyVAO);
+        allocate(width, height);
+    }
+
+    // reallocates the targets if the framebuffer size changed, a minimized window keeps the old ones
+    void Resize(int width, int height)
+    {
+        if (width > 0 && height > 0 && (width != this->width || height != this->height))
+            allocate(width, height);
+    }
+
+    void Destroy()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &accumulation);
+        glDeleteTextures(1, &alphaWeight);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteVertexArrays(1, &emptyVAO);
+        framebuffer = accumulation = alphaWeight = depth = emptyVAO = 0;
+        width = height = 0;
+    }
+
+    // call after the opaque pass: copies its depth, clears the targets and sets up the accumulation blending.
+    // Transparent geometry drawn until Composite is depth tested but doesn't write depth.
+    void Begin()
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        // the default framebuffer of GLFW is 24 bit depth with 8 bit stencil, the formats have to match for the blit
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        const float clearAccumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const float clearAlphaWeight[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+        glClearBufferfv(GL_COLOR, 1, clearAlphaWeight);
+
+        glDepthMask(GL_FALSE);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // blends the accumulated transparent surfaces over the default framebuffer and restores the global state.
+    // compositeShader is fullscreen_triangle.vs with oit_composite.fs, it reads the targets from texture units 0 and 1.
+    void Composite(Shader &compositeShader)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDepthMask(GL_TRUE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glDisable(GL_DEPTH_TEST);
+        compositeShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumulation);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, alphaWeight);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int framebuffer = 0;
+    unsigned int accumulation = 0;
+    unsigned int alphaWeight = 0;
+    unsigned int depth = 0;
+    unsigned int emptyVAO = 0;
+    int width = 0;
+    int height = 0;
+
+    void allocate(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+        glBindTexture(GL_TEXTURE_2D, accumulation);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, alphaWeight);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, alphaWeight, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::OIT::FRAMEBUFFER_INCOMPLETE " << width << "x" << height << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,20 @@
+#version 330 core
+// weighted blended order independent transparency, see include/learnopengl/weighted_oit.h for the targets
+layout (location = 0) out vec4 Accumulation;
+layout (location = 1) out vec4 AlphaWeight;
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 texColor = texture(texture1, TexCoords) * 0.8;
+    // fully transparent texels would only cost blending
+    if(texColor.a < 0.01)
+        discard;
+    // depth weight of McGuire and Bavoil, nearer and more opaque fragments count more
+    float weight = clamp(pow(min(1.0, texColor.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    Accumulation = vec4(texColor.rgb * texColor.a * weight, texColor.a);
+    AlphaWeight = vec4(texColor.a * weight);
+}
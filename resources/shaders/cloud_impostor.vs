@@ -0,0 +1,34 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+// sprites of the CloudImpostors atlas: offset and extent in the atlas, and size relative to the cloud's scale
+uniform vec4 spriteRects[8];
+uniform vec2 spriteSizes[8];
+
+void main()
+{
+    // same center as the flat cloud quad, whose x runs from 0 to 1
+    vec3 center = vec3(aInstanceModel * vec4(0.5, 0.0, 0.0, 1.0));
+    float scale = length(aInstanceModel[0].xyz);
+    // picked from the position, so a cloud keeps its sprite whatever order the clouds are drawn in
+    int sprite = int(fract(sin(dot(center, vec3(12.9898, 78.233, 37.719))) * 43758.5453) * 8.0) & 7;
+
+    // the quad turned towards the camera, along the camera's right and up axes
+    vec2 corner = vec2(aPos.x - 0.5, aPos.y);
+    vec2 size = spriteSizes[sprite] * scale;
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = center + right * corner.x * size.x + up * corner.y * size.y;
+
+    TexCoords = spriteRects[sprite].xy + (corner + 0.5) * spriteRects[sprite].zw;
+    gl_Position = projection * view * vec4(position, 1.0);
+}
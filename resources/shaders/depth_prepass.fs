@@ -0,0 +1,5 @@
+#version 330 core
+// depth only, color writes are masked off during the pre-pass
+void main()
+{
+}
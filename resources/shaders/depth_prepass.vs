@@ -0,0 +1,19 @@
+#version 330 core
+// position only stream of GeometryArena::DepthVAO, model matrix per instance
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+// computed like the shading pass's vertex shaders, so GL_EQUAL matches their depths
+invariant gl_Position;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+void main()
+{
+    vec3 FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,16 +1,15 @@
 #version 330 core
 out vec4 FragColor;
 
+// members are ordered so every float fills the padding after a vec3 (std140)
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct DirLight {
@@ -21,9 +20,10 @@ struct DirLight {
     vec3 specular;
 };
 
+// textures of all materials of a model, a draw selects its layers with MaterialLayers
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
 
     float shininess;
 };
@@ -31,12 +31,20 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+flat in vec2 MaterialLayers;
 
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform Material material;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
-uniform vec3 viewPosition;
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+uniform Material material;
 
 
 // calculates the color when using a directional light.
@@ -53,9 +61,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
 
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoords, MaterialLayers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoords, MaterialLayers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoords, MaterialLayers.y)));
     return (ambient + diffuse + specular);
 }
 
@@ -76,9 +84,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoords, MaterialLayers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoords, MaterialLayers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoords, MaterialLayers.y)).xxx);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -2,19 +2,29 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// texture array layers of the material (diffuse, specular), constant for a draw
+layout (location = 9) in vec2 aMaterialLayers;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec2 MaterialLayers;
+// the depth pre-pass computes the same position, the shading pass compares depths with GL_EQUAL
+invariant gl_Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = aNormal;
     TexCoords = aTexCoords;    
+    MaterialLayers = aMaterialLayers;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
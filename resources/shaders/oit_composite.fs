@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D alphaWeight;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumulation, texel, 0);
+    float revealage = accum.a;
+    // nothing transparent covers this pixel
+    if(revealage >= 1.0)
+        discard;
+    vec3 average = accum.rgb / max(texelFetch(alphaWeight, texel, 0).r, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+
+// heat map color of the overdraw level the stencil test lets through
+uniform vec3 color;
+
+void main()
+{
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 TexCoords;
+
+// towards the sun, the light the cloud impostors are baked with
+uniform vec3 sunDirection;
+
+void main()
+{
+    vec3 direction = normalize(TexCoords);
+    // atmosphere: deep blue at the zenith, pale at the horizon and a hazy grey blue below it
+    const vec3 zenith = vec3(0.18, 0.38, 0.72);
+    const vec3 horizon = vec3(0.70, 0.82, 0.93);
+    const vec3 below = vec3(0.45, 0.52, 0.60);
+    vec3 color = direction.y > 0.0 ? mix(horizon, zenith, sqrt(direction.y))
+                                   : mix(horizon, below, pow(-direction.y, 0.4));
+    // sun disk with a soft glow around it
+    float sun = max(dot(direction, normalize(sunDirection)), 0.0);
+    color += vec3(1.0, 0.9, 0.7) * (0.25 * pow(sun, 8.0) + 0.5 * pow(sun, 64.0) + smoothstep(0.9995, 0.9998, sun));
+    FragColor = vec4(color, 1.0);
+}
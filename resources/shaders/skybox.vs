@@ -1,15 +1,24 @@
 #version 330 core
-
-layout (location = 0) in vec3 aPos;
+// one triangle covering the screen just inside the far plane. Drawn after the opaque pass with the depth test
+// left at GL_LESS, it is rejected early wherever geometry covers the sky, so only the uncovered pixels are shaded.
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+// rounds to just below the cleared depth of 1.0 in a 24 bit depth buffer
+const float SKY_DEPTH = 0.999999;
 
 void main()
 {
-    TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
-}
\ No newline at end of file
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    // view direction through this corner, from the inverse view-projection without the view's translation.
+    // w is the same at all corners, so the direction interpolates linearly across the screen
+    vec4 direction = inverse(projection * mat4(mat3(view))) * vec4(position, 1.0, 1.0);
+    TexCoords = direction.xyz / direction.w;
+    gl_Position = vec4(position, SKY_DEPTH, 1.0);
+}
@@ -14,8 +14,25 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/asset_loader.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/transparent_batch.h>
+#include <learnopengl/weighted_oit.h>
+#include <learnopengl/cloud_impostors.h>
+#include <learnopengl/overdraw_view.h>
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/entity_store.h>
+#include <learnopengl/insect_kernels.h>
+#include <learnopengl/spatial_hash.h>
+#include <learnopengl/fixed_timestep.h>
+#include <learnopengl/job_system.h>
+
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -27,12 +44,12 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(const char* path);
-unsigned int loadCubemap(vector<std::string> faces);
-
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// clip planes of the camera's projection
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 // camera
 Camera camera(glm::vec3(0.0f, -3.5f, 0.0f));
@@ -74,21 +91,36 @@ struct ProgramState {
     void LoadFromFile(std::string filename);
 };
 
-struct Insect {
-    glm::vec3 position;
-    bool eaten;
-
-    Insect(glm::vec3 pos) : position(pos), eaten(false) {}
+// game objects, their positions are kept here instead of read back from the model matrices.
+// The simulation keeps the actors of the last two steps and frames draw them interpolated between the two;
+// the insects get their previous positions from their velocities.
+struct World {
+    Actor bird;
+    Actor falcon;
+    Actor airBalloon;
 };
-
-struct Bird {
-    glm::vec3 position;
-    bool eaten;
-
-    Bird() {}
-    Bird(glm::vec3 pos) : position(pos), eaten(false) {}
+World world;
+World previousWorld;
+InsectSwarm insects;
+
+// the simulation runs in fixed steps, LOGL_SIM_HZ sets their rate
+FixedTimestep simulationClock(120.0);
+double simulationTime = 0.0;
+// what the simulation of a frame takes from the frame that starts it, the UI can change the globals while it runs
+struct SimulationSettings {
+    unsigned int steps = 1;
+    float deltaTime = 1.0f / 120.0f;
+    // where the frame lies between the last two steps
+    float alpha = 1.0f;
+    InsectKernels::Level kernel = InsectKernels::SCALAR;
+    bool spatialHash = true;
 };
-Bird bird;
+// one step with the current settings
+SimulationSettings CurrentSimulationSettings();
+void InitWorld(const glm::vec3 &birdPosition);
+void StepSimulation(const SimulationSettings &settings);
+// LOGL_HEADLESS_SIM=seconds runs that much simulation without a window as fast as it goes, then quits
+void RunHeadlessSimulation(double seconds);
 
 float thresholdDistanceInsects = 4.0f;
 float thresholdDistanceFalcon = 5.0f;
@@ -97,11 +129,10 @@ float falconDistance = std::numeric_limits<float>::max();
 float closestInsectDistance = std::numeric_limits<float>::max();
 int closestInsectIdx = -1;
 
-glm::vec3 airBalloonPosition = glm::vec3(0.0f, -20.0f, -35.0f);
-glm::vec3 falconPosition = glm::vec3(0.0f, 0.0f, -25.0f);
+const glm::vec3 airBalloonOrbitCenter = glm::vec3(0.0f, -20.0f, -35.0f);
 
 //insects positions
-vector<Insect> insects
+const glm::vec3 handPlacedInsectPositions[]
         {
                 glm::vec3( 0.0f, -6.0f, -35.0f),
                 glm::vec3(-8.0f, -5.0f, -40.0f),
@@ -109,7 +140,156 @@ vector<Insect> insects
                 glm::vec3 (-10.0f, -4.5f, -35.0f),
                 glm::vec3(-4.0f, -4.0f, -40.0f)
         };
-int remainingInsects = insects.size();
+const unsigned int handPlacedInsects = sizeof(handPlacedInsectPositions) / sizeof(handPlacedInsectPositions[0]);
+
+// stress mode: extra insects scattered around the hand placed ones
+void SpawnInsectSwarm(unsigned int count);
+bool instancedInsects = true;
+unsigned int insectDrawCalls = 0;
+
+// the per-frame work runs on a work-stealing job system, LOGL_JOB_THREADS sets its threads (the main thread included)
+JobSystem *jobs;
+// insects per job of the parallel insect passes, a multiple of 8 so the ranges split along the SIMD vectors
+const unsigned int INSECT_JOB_GRAIN = 16384;
+// job time of every thread during the last frame, and that frame's time, for the utilization readout
+vector<double> jobBusyMs;
+double jobFrameMs = 0.0;
+
+// what a frame draws and shows of the simulation. The simulation started by a frame runs on the job system while
+// the frame is culled and drawn, and fills the other snapshot, so frames show the simulation one frame late
+struct SimulationFrame {
+    vector<glm::mat4> insectTransforms;
+    glm::vec3 airBalloonPosition = glm::vec3(0.0f);
+    glm::vec3 falconPosition = glm::vec3(0.0f);
+    float renderTime = 0.0f;
+    bool birdAlive = true;
+    unsigned int remainingInsects = 0;
+    bool closestInsectFound = false;
+    glm::vec3 closestInsectPosition = glm::vec3(0.0f);
+    float closestInsectDistance = std::numeric_limits<float>::max();
+    float falconDistance = std::numeric_limits<float>::max();
+    // the steps, and building the insect transforms
+    unsigned int steps = 0;
+    double simulationMs = 0.0;
+    double transformsMs = 0.0;
+    double gridBuildMs = 0.0;
+    double queryMs = 0.0;
+};
+SimulationFrame simulationFrames[2];
+SimulationFrame *shownFrame = &simulationFrames[0];
+SimulationFrame *nextFrame = &simulationFrames[1];
+// the simulation of a frame as a job graph: the steps, then the insect transforms and the rest of the snapshot
+SimulationSettings launchedSimulation;
+JobGraph simulationGraph;
+JobCounter simulationDone;
+void BuildSimulationGraph();
+void PublishInsectTransforms(SimulationFrame &frame, const SimulationSettings &settings);
+void PublishSimulationState(SimulationFrame &frame, const SimulationSettings &settings);
+// the swarm of the Spawn swarm button, spawned at the start of the next frame when the simulation isn't running
+int pendingSwarmSpawn = -1;
+// LOGL_JOB_BENCHMARK=1 measures the frame time with 1 to all threads of the job system, then quits. The swarm is
+// JOB_BENCHMARK_SWARM insects unless LOGL_INSECT_SWARM says otherwise
+const unsigned int JOB_BENCHMARK_SWARM = 200000;
+const unsigned int JOB_BENCHMARK_WARMUP = 30;
+const unsigned int JOB_BENCHMARK_FRAMES = 240;
+bool jobBenchmark = false;
+void StepJobBenchmark(GLFWwindow *window);
+// the insect step split into ranges that run in parallel
+InsectStepResult StepInsects(float time, float deltaTime, const glm::vec3 &birdPosition, float captureRadius,
+                             InsectKernels::Level kernel);
+// only the motion of the step, in parallel
+void MoveInsects(float time, float deltaTime, InsectKernels::Level kernel);
+
+// LOGL_INSECT_BENCHMARK=1 times the insect step with every kernel the CPU runs at these swarm sizes, then quits
+const unsigned int insectBenchmarkSizes[] = {1000, 100000, 1000000};
+const unsigned int INSECT_BENCHMARK_WARMUP = 10;
+const unsigned int INSECT_BENCHMARK_STEPS = 100;
+void RunInsectBenchmark();
+
+// captures and the nearest insect found through a spatial hash of the insects instead of the linear scan of the
+// step, so they cost the same for any swarm size. Its cells are as large as the larger of the two query radii.
+bool spatialHashQueries = true;
+SpatialHash insectGrid;
+double insectGridBuildMs = 0.0;
+double insectQueryMs = 0.0;
+InsectStepResult StepInsectsWithGrid(float time, float deltaTime, const glm::vec3 &birdPosition, InsectKernels::Level kernel);
+// LOGL_SPATIAL_HASH_BENCHMARK=1 checks the hash queries against brute force and times both at these sizes, then quits
+const unsigned int spatialHashBenchmarkSizes[] = {1000, 10000, 100000, 1000000};
+const unsigned int SPATIAL_HASH_BENCHMARK_QUERIES = 1000;
+int RunSpatialHashBenchmark();
+
+// transparent clouds locations
+// --------------------------------
+vector<glm::vec3> clouds
+        {
+                glm::vec3(-3.0f, -1.0f, -3.0f),
+                glm::vec3(-2.95f, -2.0f, -6.0f),
+                glm::vec3(-2.9f, 0.0f, -6.0f),
+                glm::vec3(-2.5f, -1.0f, -9.0f),
+                glm::vec3(-1.6f, -2.0f, -12.0f),
+                glm::vec3(-1.5f, 0.0f, -12.0f),
+                glm::vec3(0.0f, -1.0f, -15.0f),
+
+                glm::vec3(1.5f, 0.0f, -12.0f),
+                glm::vec3(1.6f, -2.0f, -12.0f),
+                glm::vec3(2.5f, -1.0f, -9.0f),
+                glm::vec3(2.9f, 0.0f, -6.0f),
+                glm::vec3(2.95f, -2.0f, -6.0f),
+                glm::vec3(3.0f, -1.0f, -3.0f)
+        };
+const unsigned int handPlacedClouds = clouds.size();
+// adds count random clouds to the hand placed ones, for dense sky scenes
+void SpawnCloudField(unsigned int count);
+// transparent pass statistics of the last frame, shown in the Performance window
+unsigned int visibleClouds = 0;
+double cloudSortMs = 0.0;
+double cloudPassMs = 0.0;
+// clouds blended with weighted blended order independent transparency instead of sorted back to front
+bool orderIndependentClouds = false;
+// clouds drawn as camera facing sprites of the baked impostor atlas instead of flat textured quads
+bool impostorClouds = true;
+
+// LOGL_CLOUD_BENCHMARK=1 measures the frame time at each of these cloud counts, sorted and order independent, then quits
+const unsigned int cloudBenchmarkSizes[] = {100, 1000, 10000};
+const unsigned int CLOUD_BENCHMARK_WARMUP = 30;
+const unsigned int CLOUD_BENCHMARK_FRAMES = 240;
+bool cloudBenchmark = false;
+void StepCloudBenchmark(GLFWwindow *window);
+
+// frustum culling statistics, shown in the Performance window
+bool frustumCulling = true;
+// objects per job when bounds are computed and culled in parallel
+const unsigned int CULL_JOB_GRAIN = 8192;
+unsigned int visibleObjects = 0;
+unsigned int culledObjects = 0;
+
+// render queue state change counters of the last frame, shown in the Performance window
+bool sortRenderQueue = true;
+RenderQueue::Stats renderStats;
+// batch queued draws into glMultiDrawElementsIndirect calls where the driver has it
+bool multiDrawIndirect = false;
+// opaque pipeline: depth only pre-pass with GL_EQUAL shading, or plain nearest first order
+bool depthPrepass = false;
+bool frontToBack = false;
+// paints the opaque pass by the number of fragments drawn per pixel
+bool overdrawView = false;
+// samples passing the depth test in the opaque shading pass, per pixel of the framebuffer
+double shadedSamplesPerPixel = 0.0;
+
+// sky shaded by sky_procedural.fs instead of sampled from the cubemap. Builds with LOGL_PROCEDURAL_SKY_ONLY
+// (cmake -DLOGL_PROCEDURAL_SKY_ONLY=ON) don't load the cubemap at all and always draw it
+#ifdef LOGL_PROCEDURAL_SKY_ONLY
+const bool skyCubemapAvailable = false;
+#else
+const bool skyCubemapAvailable = true;
+#endif
+bool proceduralSky = !skyCubemapAvailable;
+// towards the sun: the procedural sky draws it there and the cloud impostors are lit from it
+const glm::vec3 sunDirection = glm::vec3(0.4f, 0.8f, -0.45f);
+
+// detail level selection: the coarsest level whose error stays below lodErrorPixels on screen
+bool levelOfDetail = true;
+float lodErrorPixels = 1.0f;
 
 void ProgramState::SaveToFile(std::string filename) {
     std::ofstream out(filename);
@@ -142,10 +322,35 @@ void ProgramState::LoadFromFile(std::string filename) {
 }
 
 ProgramState *programState;
+AssetLoader *assetLoader;
 
 void DrawImGui(ProgramState *programState);
 
 int main() {
+    // the insect kernels are picked for this CPU, LOGL_INSECT_SIMD=0 forces the scalar one
+    InsectKernels::Init();
+    if (const char *benchmark = getenv("LOGL_INSECT_BENCHMARK")) {
+        if (strcmp(benchmark, "0") != 0) {
+            RunInsectBenchmark();
+            return 0;
+        }
+    }
+    if (const char *benchmark = getenv("LOGL_SPATIAL_HASH_BENCHMARK")) {
+        if (strcmp(benchmark, "0") != 0)
+            return RunSpatialHashBenchmark();
+    }
+    if (const char *grid = getenv("LOGL_SPATIAL_HASH"))
+        spatialHashQueries = strcmp(grid, "0") != 0;
+    if (const char *rate = getenv("LOGL_SIM_HZ"))
+        simulationClock.SetRate(std::max(atof(rate), 1.0));
+    jobs = new JobSystem(ThreadPool::DefaultThreadCount("LOGL_JOB_THREADS"));
+    std::cout << "JOB_SYSTEM:: " << jobs->ThreadCount() << " threads" << std::endl;
+    if (const char *headless = getenv("LOGL_HEADLESS_SIM")) {
+        RunHeadlessSimulation(atof(headless));
+        delete jobs;
+        return 0;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -183,6 +388,15 @@ int main() {
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
+    // textures are block compressed when the driver supports it, LOGL_TEXTURE_COMPRESSION=0 turns it off
+    TextureCompression::Init();
+    // indirect multi draws need GL 4.3 or ARB_multi_draw_indirect, LOGL_MULTI_DRAW=0 starts without them
+    MultiDrawIndirect::Init((GLADloadproc) glfwGetProcAddress);
+    multiDrawIndirect = MultiDrawIndirect::EnabledByDefault();
+
+    // models and textures are imported and decoded on worker threads and uploaded during the first frames
+    assetLoader = new AssetLoader();
+
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
     if (programState->ImGuiEnabled) {
@@ -212,53 +426,19 @@ int main() {
     // build and compile shaders
     // -------------------------
     Shader modelShader("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
+    Shader instancedModelShader("resources/shaders/model_lighting_instanced.vs", "resources/shaders/model_lighting.fs");
     Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    Shader blendingOITShader("resources/shaders/blending.vs", "resources/shaders/blending_oit.fs");
+    Shader impostorShader("resources/shaders/cloud_impostor.vs", "resources/shaders/blending.fs");
+    Shader impostorOITShader("resources/shaders/cloud_impostor.vs", "resources/shaders/blending_oit.fs");
+    Shader oitCompositeShader("resources/shaders/fullscreen_triangle.vs", "resources/shaders/oit_composite.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    Shader proceduralSkyShader("resources/shaders/skybox.vs", "resources/shaders/sky_procedural.fs");
+    Shader depthShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader overdrawShader("resources/shaders/fullscreen_triangle.vs", "resources/shaders/overdraw.fs");
 
-    float skyboxVertices[] = {
-            // positions
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f
-    };
+    // per-draw uniforms, resolved once
+    Uniform<glm::mat4> modelShaderModel = modelShader.GetUniform<glm::mat4>("model");
 
     float transparentVertices[] = {
             // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
@@ -271,29 +451,34 @@ int main() {
             1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
 
-    // transparent VAO
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
+    // transparent VBO
+    unsigned int transparentVBO;
     glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-
-    // skybox VAO
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // all visible clouds are sorted back to front and drawn with one instanced call, the batch has the VAO
+    TransparentBatch cloudBatch;
+    cloudBatch.Init(transparentVBO, 6);
+    // targets of the order independent mode, LOGL_CLOUD_OIT=1 starts in it
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    WeightedBlendedOIT cloudTransparency;
+    cloudTransparency.Init(framebufferWidth, framebufferHeight);
+    if (const char *cloudOIT = getenv("LOGL_CLOUD_OIT"))
+        orderIndependentClouds = strcmp(cloudOIT, "0") != 0;
+    GpuTimer cloudTimer;
+    cloudTimer.Init();
+
+    // the sky is one fullscreen triangle made in skybox.vs, core profile draws still need a bound VAO
+    unsigned int skyVAO;
+    glGenVertexArrays(1, &skyVAO);
+    // LOGL_PROCEDURAL_SKY=1 starts with the procedural sky
+    if (const char *procedural = getenv("LOGL_PROCEDURAL_SKY"))
+        proceduralSky = !skyCubemapAvailable || strcmp(procedural, "0") != 0;
+
+    unsigned int cubemapTexture = 0;
+#ifndef LOGL_PROCEDURAL_SKY_ONLY
     vector<std::string> faces
             {
                     FileSystem::getPath("resources/textures/skybox/rt.jpg"),
@@ -303,46 +488,86 @@ int main() {
                     FileSystem::getPath("resources/textures/skybox/ft.jpg"),
                     FileSystem::getPath("resources/textures/skybox/bk.jpg")
             };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    const unsigned char skyPlaceholder[4] = {135, 175, 215, 255};
+    cubemapTexture = assetLoader->LoadCubemap(faces, skyPlaceholder);
+#endif
 
-    unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/transparent_cloud1.png").c_str());
+    unsigned int transparentTexture = assetLoader->LoadTexture(FileSystem::getPath("resources/textures/transparent_cloud1.png"), true,
+                                                               AssetLoader::PLACEHOLDER_TRANSPARENT);
+    // lit cloud sprites baked from the cloud maps, the flat quads are drawn until the atlas is ready.
+    // The light comes from above and behind the clouds, so their thin edges light up. LOGL_CLOUD_IMPOSTORS=0 keeps the quads.
+    CloudImpostors cloudImpostors;
+    assetLoader->LoadCloudImpostors(cloudImpostors, FileSystem::getPath("resources/objects/cloud"), sunDirection);
+    if (const char *impostors = getenv("LOGL_CLOUD_IMPOSTORS"))
+        impostorClouds = strcmp(impostors, "0") != 0;
+    bool impostorSpritesSet = false;
+
+    // clouds don't move, their transforms are computed again only when clouds are added (see SpawnCloudField)
+    vector<glm::mat4> cloudTransforms;
+    auto updateCloudTransforms = [&]() {
+        cloudTransforms.clear();
+        for (const glm::vec3 &cloud : clouds)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::scale(model, glm::vec3(5.0f));
+            model = glm::translate(model, cloud);
+            cloudTransforms.push_back(model);
+        }
+    };
+    // LOGL_CLOUD_FIELD=N starts with N extra clouds, for measuring the transparent pass
+    if (const char *cloudField = getenv("LOGL_CLOUD_FIELD"))
+        SpawnCloudField(atoi(cloudField));
+    if (const char *benchmark = getenv("LOGL_CLOUD_BENCHMARK")) {
+        cloudBenchmark = strcmp(benchmark, "0") != 0;
+        // frame times limited by the refresh rate wouldn't show anything
+        if (cloudBenchmark)
+            glfwSwapInterval(0);
+    }
+    updateCloudTransforms();
+    const glm::vec3 cloudBoundsMin(0.0f, -0.5f, 0.0f);
+    const glm::vec3 cloudBoundsMax(1.0f, 0.5f, 0.0f);
+    // a camera facing sprite can turn any way around the quad's center
+    const float impostorRadius = 0.5f * CloudImpostors::PUFF_SCALE;
+    const glm::vec3 impostorBoundsMin = glm::vec3(0.5f, 0.0f, 0.0f) - glm::vec3(impostorRadius);
+    const glm::vec3 impostorBoundsMax = glm::vec3(0.5f, 0.0f, 0.0f) + glm::vec3(impostorRadius);
 
-    // transparent clouds locations
-    // --------------------------------
-    vector<glm::vec3> clouds
-            {
-                    glm::vec3(-3.0f, -1.0f, -3.0f),
-                    glm::vec3(-2.95f, -2.0f, -6.0f),
-                    glm::vec3(-2.9f, 0.0f, -6.0f),
-                    glm::vec3(-2.5f, -1.0f, -9.0f),
-                    glm::vec3(-1.6f, -2.0f, -12.0f),
-                    glm::vec3(-1.5f, 0.0f, -12.0f),
-                    glm::vec3(0.0f, -1.0f, -15.0f),
-
-                    glm::vec3(1.5f, 0.0f, -12.0f),
-                    glm::vec3(1.6f, -2.0f, -12.0f),
-                    glm::vec3(2.5f, -1.0f, -9.0f),
-                    glm::vec3(2.9f, 0.0f, -6.0f),
-                    glm::vec3(2.95f, -2.0f, -6.0f),
-                    glm::vec3(3.0f, -1.0f, -3.0f)
-            };
     blendingShader.use();
     blendingShader.setInt("texture1", 0);
+    blendingOITShader.use();
+    blendingOITShader.setInt("texture1", 0);
+    impostorShader.use();
+    impostorShader.setInt("texture1", 0);
+    impostorOITShader.use();
+    impostorOITShader.setInt("texture1", 0);
+    oitCompositeShader.use();
+    oitCompositeShader.setInt("accumulation", 0);
+    oitCompositeShader.setInt("alphaWeight", 1);
 
     // shader configuration
     // --------------------
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
+    proceduralSkyShader.use();
+    proceduralSkyShader.setVec3("sunDirection", sunDirection);
+
+    modelShader.use();
+    modelShader.setFloat("material.shininess", 32.0f);
+    instancedModelShader.use();
+    instancedModelShader.setFloat("material.shininess", 32.0f);
+
+    // projection, view and lights are shared by all shaders through uniform buffers
+    FrameUniforms frameUniforms;
+    frameUniforms.Init();
 
 
 
     // load models
     // -----------
-    Model ourModel("resources/objects/backpack/backpack.obj");
-    Model abModel("resources/objects/air_balloon/11809_Hot_air_balloon_l2.obj");
-    Model fModel("resources/objects/falcon/peregrine_falcon.obj");
-    Model bModel("resources/objects/bird/bird.obj");
-    Model iModel("resources/objects/insect/insect.obj");
+    Model ourModel;
+    Model abModel;
+    Model fModel;
+    Model bModel;
+    Model iModel;
 
     ourModel.SetShaderTextureNamePrefix("material.");
     abModel.SetShaderTextureNamePrefix("material.");
@@ -350,6 +575,20 @@ int main() {
     bModel.SetShaderTextureNamePrefix("material.");
     iModel.SetShaderTextureNamePrefix("material.");
 
+    // vertices only carry the streams the model shaders read, packed. LOGL_VERTEX_FORMAT=full keeps the 56 byte layout.
+    const char *vertexFormat = getenv("LOGL_VERTEX_FORMAT");
+    VertexLayout modelLayout = vertexFormat && std::string(vertexFormat) == "full" ? VertexLayout::Full()
+                               : VertexLayout::ForShaders({&modelShader, &instancedModelShader});
+    for (Model *model : {&ourModel, &abModel, &fModel, &bModel, &iModel})
+        model->SetVertexLayout(modelLayout);
+
+    // meshes show up as soon as they are uploaded, untextured until their images arrive
+    assetLoader->LoadModel(ourModel, "resources/objects/backpack/backpack.obj");
+    assetLoader->LoadModel(abModel, "resources/objects/air_balloon/11809_Hot_air_balloon_l2.obj");
+    assetLoader->LoadModel(fModel, "resources/objects/falcon/peregrine_falcon.obj");
+    assetLoader->LoadModel(bModel, "resources/objects/bird/bird.obj");
+    assetLoader->LoadModel(iModel, "resources/objects/insect/insect.obj");
+
 
     PointLight& pointLight = programState->pointLight;
     pointLight.position = glm::vec3(2.0f, 2.0, -30.0);
@@ -362,7 +601,33 @@ int main() {
     pointLight.quadratic = 0.002f;
 
 
-    bird = Bird(programState->modelRelativePosition);
+    InitWorld(programState->modelPosition);
+
+    if (const char *benchmark = getenv("LOGL_JOB_BENCHMARK")) {
+        jobBenchmark = strcmp(benchmark, "0") != 0;
+        if (jobBenchmark)
+            glfwSwapInterval(0);
+    }
+    // LOGL_INSECT_SWARM=N starts with N extra insects, for measuring frame time against swarm size
+    const char *swarm = getenv("LOGL_INSECT_SWARM");
+    SpawnInsectSwarm(swarm ? atoi(swarm) : jobBenchmark ? JOB_BENCHMARK_SWARM : 0);
+    // the first frame swaps in the state at simulation time 0
+    BuildSimulationGraph();
+    PublishInsectTransforms(*nextFrame, CurrentSimulationSettings());
+    PublishSimulationState(*nextFrame, CurrentSimulationSettings());
+    vector<glm::mat4> visibleInsectTransforms;
+    vector<unsigned int> insectLods;
+    SphereCuller culler;
+    RenderQueue renderQueue;
+    // single draws of modelShader can join the multi draws of the insects
+    renderQueue.SetInstancedVariant(modelShader, instancedModelShader);
+    renderQueue.SetDepthShader(depthShader);
+    // LOGL_DEPTH_PREPASS=1 starts with the depth pre-pass on
+    if (const char *prepass = getenv("LOGL_DEPTH_PREPASS"))
+        depthPrepass = strcmp(prepass, "0") != 0;
+    OverdrawView overdraw;
+    overdraw.Init();
+    GLStateCache glState;
 
 
     // draw in wireframe
@@ -377,19 +642,46 @@ int main() {
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        if (cloudBenchmark)
+            StepCloudBenchmark(window);
+
+        // the simulation started by the last frame has to be done: its snapshot is what this frame draws, and
+        // the game state is the main thread's until the next one starts
+        jobs->Wait(simulationDone);
+        std::swap(shownFrame, nextFrame);
+        const SimulationFrame &simulation = *shownFrame;
+        jobs->TakeBusyMs(jobBusyMs);
+        jobFrameMs = deltaTime * 1000.0;
+        if (jobBenchmark)
+            StepJobBenchmark(window);
+        if (pendingSwarmSpawn >= 0) {
+            SpawnInsectSwarm(pendingSwarmSpawn);
+            pendingSwarmSpawn = -1;
+        }
+
         // input
         // -----
         processInput(window);
 
+        // simulation: the fixed steps that fit in the time since the last frame, on the job system while this
+        // frame is culled and drawn. The bird follows the camera
+        world.bird.position = programState->modelPosition;
+        launchedSimulation = CurrentSimulationSettings();
+        launchedSimulation.steps = simulationClock.Advance(deltaTime);
+        launchedSimulation.alpha = simulationClock.Alpha();
+        simulationGraph.Run(*jobs, simulationDone);
+
+        // streamed assets, bounded so loading never stalls a frame for long
+        assetLoader->ProcessUploads(4.0);
+
 
         // render
         // ------
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
+        // the stencil buffer is only used to count overdraw, clearing it with depth costs nothing extra
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-        // don't forget to enable shader before setting uniforms
-        modelShader.use();
 
         //pointLight position
         float radius = 5.0f;
@@ -400,155 +692,226 @@ int main() {
         float z = centerZ + radius * sin(angle);
         pointLight.position = glm::vec3(x, 2.0f, z);
 
-        // point light setup
-        modelShader.setVec3("pointLight.position", pointLight.position);
-        modelShader.setVec3("pointLight.ambient", pointLight.ambient);
-        modelShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        modelShader.setVec3("pointLight.specular", pointLight.specular);
-        modelShader.setFloat("pointLight.constant", pointLight.constant);
-        modelShader.setFloat("pointLight.linear", pointLight.linear);
-        modelShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        modelShader.setVec3("viewPosition", programState->camera.Position);
-        modelShader.setFloat("material.shininess", 32.0f);
-
-        // directional light setup
-        modelShader.setVec3("dirLight.direction", glm::vec3(-10.0f, 10.0f, 0.0f));
-        modelShader.setVec3("dirLight.ambient", glm::vec3(0.05f));
-        modelShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
-        modelShader.setVec3("dirLight.specular", glm::vec3(0.5f));
-
         // view/projection transformations
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
         glm::mat4 view = programState->camera.GetViewMatrix();
 
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
+        // camera and light data for all shaders, uploaded once per frame
+        CameraBlock &cameraBlock = frameUniforms.camera;
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewPosition = programState->camera.Position;
+
+        // point light setup
+        PointLightBlock &pointLightBlock = frameUniforms.lights.pointLight;
+        pointLightBlock.position = pointLight.position;
+        pointLightBlock.ambient = pointLight.ambient;
+        pointLightBlock.diffuse = pointLight.diffuse;
+        pointLightBlock.specular = pointLight.specular;
+        pointLightBlock.constant = pointLight.constant;
+        pointLightBlock.linear = pointLight.linear;
+        pointLightBlock.quadratic = pointLight.quadratic;
+
+        // directional light setup
+        DirLightBlock &dirLightBlock = frameUniforms.lights.dirLight;
+        dirLightBlock.direction = glm::vec3(-10.0f, 10.0f, 0.0f);
+        dirLightBlock.ambient = glm::vec3(0.05f);
+        dirLightBlock.diffuse = glm::vec3(0.4f);
+        dirLightBlock.specular = glm::vec3(0.5f);
 
+        frameUniforms.Upload();
 
 
-        // render the loaded model
+
+        // object transforms
+        // -----------------
+        const vector<glm::mat4> &insectTransforms = simulation.insectTransforms;
 
         // air balloon
-        modelShader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, airBalloonPosition);
-        model = glm::scale(model, glm::vec3(0.01f));
-        model = glm::translate(model,glm::vec3(cos(0.1f*currentFrame)*3600.0f, 0.0f, sin(0.1f*currentFrame)*3600.0f+1000));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        modelShader.setMat4("model", model);
-        abModel.Draw(modelShader);
+        glm::mat4 balloonModel = glm::translate(glm::mat4(1.0f), simulation.airBalloonPosition);
+        balloonModel = glm::scale(balloonModel, glm::vec3(0.01f));
+        balloonModel = glm::rotate(balloonModel, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
 
         // falcon
-        modelShader.use();
-        model = glm::mat4(0.8f);
-        model = glm::translate(model, falconPosition);
-        model = glm::scale(model, glm::vec3(0.2f));
-        model = glm::translate(model,glm::vec3(cos(0.15*currentFrame)*50.0f, -5.0f, sin(0.15*currentFrame)*50.0f));
-        model = glm::rotate(model, glm::radians(0.15f*currentFrame), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        modelShader.setMat4("model", model);
-        fModel.Draw(modelShader);
-        falconPosition = glm::vec3(model[3]);
-        falconDistance = glm::distance(programState->modelPosition, falconPosition);
+        const glm::vec3 &falconPosition = simulation.falconPosition;
+        glm::mat4 falconModel = glm::translate(glm::mat4(1.0f), falconPosition);
+        falconModel = glm::scale(falconModel, glm::vec3(0.2f));
+        falconModel = glm::rotate(falconModel, glm::radians(0.15f*simulation.renderTime), glm::vec3(0.0f, 1.0f, 0.0f));
+        falconModel = glm::rotate(falconModel, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
 
         // bird
-        // check is the bird eaten by falcon
-        if (falconDistance < thresholdDistanceFalcon) {
-            bird.eaten = true;
-        }
-
-        // render the bird
-        if(!bird.eaten) {
-            modelShader.use();
-            model = glm::translate(glm::mat4(1.0f),
-                                   programState->modelRelativePosition);   // update model position based on camera
-            model = glm::scale(model, glm::vec3(programState->modelScale));
-            model = glm::translate(model, glm::vec3(0.0f, sin(2.5f * currentFrame) * 0.5f, 0.0f));
-            model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            modelShader.setMat4("model", model);
-            bModel.Draw(modelShader);
+        glm::mat4 birdModel = glm::translate(glm::mat4(1.0f),
+                                             programState->modelRelativePosition);   // update model position based on camera
+        birdModel = glm::scale(birdModel, glm::vec3(programState->modelScale));
+        birdModel = glm::translate(birdModel, glm::vec3(0.0f, sin(2.5f * currentFrame) * 0.5f, 0.0f));
+        birdModel = glm::rotate(birdModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+
+        // frustum culling: the bounds of every object are tested in one pass before anything is drawn, the
+        // swarm and cloud bounds and the tests in parallel
+        // -------------------------------------------------------------------------------------------------
+        culler.Clear();
+        unsigned int balloonBounds = culler.Add(balloonModel, abModel.boundsMin, abModel.boundsMax);
+        unsigned int falconBounds = culler.Add(falconModel, fModel.boundsMin, fModel.boundsMax);
+        unsigned int birdBounds = culler.Add(birdModel, bModel.boundsMin, bModel.boundsMax);
+        unsigned int firstInsectBounds = culler.Append(insectTransforms.size());
+        jobs->ParallelFor(0, insectTransforms.size(), CULL_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                culler.Set(firstInsectBounds + i, insectTransforms[i], iModel.boundsMin, iModel.boundsMax);
+        });
+        if (cloudTransforms.size() != clouds.size())
+            updateCloudTransforms();
+        bool useImpostors = impostorClouds && cloudImpostors.Ready();
+        unsigned int firstCloudBounds = culler.Append(cloudTransforms.size());
+        jobs->ParallelFor(0, cloudTransforms.size(), CULL_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                culler.Set(firstCloudBounds + i, cloudTransforms[i], useImpostors ? impostorBoundsMin : cloudBoundsMin,
+                           useImpostors ? impostorBoundsMax : cloudBoundsMax);
+        });
+
+        if (frustumCulling) {
+            const Frustum frustum(projection * view);
+            std::atomic<unsigned int> visibleCount(0);
+            jobs->ParallelFor(0, culler.Count(), CULL_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+                visibleCount += culler.CullRange(frustum, begin, end);
+            });
+            culler.visibleCount = visibleCount;
+        } else {
+            culler.AcceptAll();
         }
 
 
-        // insects
+        // render the loaded models
+        // ------------------------
+        // opaque draws are queued and submitted sorted by program, material and vertex array
+        const glm::vec3 &viewPosition = programState->camera.Position;
+        renderQueue.multiDraw = multiDrawIndirect;
+        renderQueue.depthPrepass = depthPrepass;
+        renderQueue.frontToBack = frontToBack;
+        renderQueue.SetDepthRange(NEAR_PLANE, FAR_PLANE);
+        auto selectLod = [&](const Model &model, const glm::mat4 &transform) {
+            if (!levelOfDetail)
+                return 0u;
+            return model.SelectLod(ProjectedPixelsPerUnit(transform, viewPosition, projection, (float)SCR_HEIGHT), lodErrorPixels);
+        };
+        if (culler.Visible(balloonBounds))
+            renderQueue.Submit(modelShader, modelShaderModel, abModel, balloonModel, glm::distance(viewPosition, glm::vec3(balloonModel[3])),
+                               selectLod(abModel, balloonModel));
 
-        // check if insects are eaten by bird
-        for (unsigned int i = 0; i < insects.size(); i++) {
+        if (culler.Visible(falconBounds))
+            renderQueue.Submit(modelShader, modelShaderModel, fModel, falconModel, glm::distance(viewPosition, falconPosition),
+                               selectLod(fModel, falconModel));
 
-            if (!insects[i].eaten) {
-                // calculate the distance between the bird and the insect
-                float distance = glm::distance(programState->modelPosition, insects[i].position);
+        // render the bird
+        if(simulation.birdAlive && culler.Visible(birdBounds))
+            renderQueue.Submit(modelShader, modelShaderModel, bModel, birdModel, glm::distance(viewPosition, glm::vec3(birdModel[3])),
+                               selectLod(bModel, birdModel));
 
-                // check if the bird is close to the insect
-                if (distance < thresholdDistanceInsects) {
-                    insects[i].eaten = true;
-                    remainingInsects--;
+        // render visible insects
+        // visible insects grouped by detail level, so every level is one instanced draw. The levels are picked
+        // in parallel, LOD_LEVELS marks the culled insects
+        insectLods.resize(insectTransforms.size());
+        jobs->ParallelFor(0, insectTransforms.size(), CULL_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                insectLods[i] = culler.Visible(firstInsectBounds + i) ? selectLod(iModel, insectTransforms[i]) : LOD_LEVELS;
+        });
+        unsigned int insectLodCounts[LOD_LEVELS] = {0};
+        for (unsigned int lod : insectLods) {
+            if (lod < LOD_LEVELS)
+                insectLodCounts[lod]++;
+        }
+        unsigned int insectLodStart[LOD_LEVELS] = {0};
+        for (unsigned int level = 1; level < LOD_LEVELS; level++)
+            insectLodStart[level] = insectLodStart[level - 1] + insectLodCounts[level - 1];
+        visibleInsectTransforms.resize(insectLodStart[LOD_LEVELS - 1] + insectLodCounts[LOD_LEVELS - 1]);
+        for (unsigned int i = 0; i < insectTransforms.size(); i++) {
+            if (insectLods[i] < LOD_LEVELS)
+                visibleInsectTransforms[insectLodStart[insectLods[i]]++] = insectTransforms[i];
+        }
+        if (instancedInsects) {
+            // one draw call per insect mesh and detail level for the whole swarm
+            renderQueue.SubmitInstanced(instancedModelShader, iModel, visibleInsectTransforms.data(), visibleInsectTransforms.size(), 0.0f,
+                                        insectLodCounts);
+            insectDrawCalls = 0;
+            for (unsigned int count : insectLodCounts)
+                insectDrawCalls += count > 0 ? iModel.meshes.size() : 0;
+        } else {
+            for (unsigned int level = 0, i = 0; level < LOD_LEVELS; level++) {
+                for (unsigned int end = i + insectLodCounts[level]; i < end; i++) {
+                    const glm::mat4 &insectModel = visibleInsectTransforms[i];
+                    renderQueue.Submit(modelShader, modelShaderModel, iModel, insectModel, glm::distance(viewPosition, glm::vec3(insectModel[3])), level);
                 }
             }
+            insectDrawCalls = visibleInsectTransforms.size() * iModel.meshes.size();
         }
 
-        // render visible insects
-        modelShader.use();
-        for (unsigned int i = 0; i < insects.size(); i++) {
-            if (!(insects[i].eaten)) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, insects[i].position);
-                model = glm::scale(model, glm::vec3(0.01f));
-                model = glm::translate(model,glm::vec3(sin(currentFrame/(i+3)) * (i+8), 0.0f, cos(currentFrame*(i+2))));
-                modelShader.setMat4("model", model);
-                iModel.Draw(modelShader);
-
-                // update the position attribute of the insect
-                insects[i].position = glm::vec3(model[3]);   // extract the translation part from the final model matrix
-            }
-        }
+        renderQueue.sortAndSkip = sortRenderQueue;
+        if (overdrawView)
+            overdraw.BeginCounting();
+        renderQueue.Flush(glState);
+        if (overdrawView)
+            overdraw.EndCounting();
+        renderStats = renderQueue.stats;
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+            shadedSamplesPerPixel = (double)renderStats.shadedSamples / ((double)framebufferWidth * framebufferHeight);
 
-        // update the insect closest to the bird
-        closestInsectDistance = std::numeric_limits<float>::max();
-        for (unsigned int i = 0; i < insects.size(); i++) {
-            if(!(insects[i].eaten)) {
-                unsigned distance = glm::distance(programState->modelPosition, insects[i].position);
-                if (distance < closestInsectDistance) {
-                    closestInsectDistance = distance;
-                    closestInsectIdx = i;
-                }
-            }
+
+        visibleObjects = culler.visibleCount;
+        culledObjects = culler.Count() - culler.visibleCount;
+
+
+        // draw the sky last of the opaque pass, so the depth test skips every covered pixel,
+        // and before the clouds so they blend over it
+        if (proceduralSky) {
+            proceduralSkyShader.use();
+        } else {
+            skyboxShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
         }
+        glBindVertexArray(skyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
 
 
         // TEXTURES
-        // transparent clouds
-        blendingShader.use();
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, transparentTexture);
-        for (unsigned int i = 0; i < clouds.size(); i++)
+        // transparent clouds, blended back to front or accumulated in any order
+        cloudTimer.Begin();
+        for (unsigned int i = 0; i < cloudTransforms.size(); i++)
         {
-            model = glm::mat4(1.0f);
-            model = glm::scale(model, glm::vec3(5.0f));
-            model = glm::translate(model, clouds[i]);
-            blendingShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            if (!culler.Visible(firstCloudBounds + i))
+                continue;
+            glm::vec3 center = glm::vec3(cloudTransforms[i] * glm::vec4(0.5f, 0.0f, 0.0f, 1.0f));
+            cloudBatch.Add(cloudTransforms[i], orderIndependentClouds ? 0.0f : glm::distance(viewPosition, center));
         }
+        if (useImpostors && !impostorSpritesSet) {
+            cloudImpostors.SetUniforms(impostorShader);
+            cloudImpostors.SetUniforms(impostorOITShader);
+            impostorSpritesSet = true;
+        }
+        if (orderIndependentClouds) {
+            cloudTransparency.Resize(framebufferWidth, framebufferHeight);
+            cloudTransparency.Begin();
+            (useImpostors ? impostorOITShader : blendingOITShader).use();
+        } else {
+            (useImpostors ? impostorShader : blendingShader).use();
+        }
+        glBindTexture(GL_TEXTURE_2D, useImpostors ? cloudImpostors.Texture() : transparentTexture);
+        cloudBatch.Draw(!orderIndependentClouds);
+        if (orderIndependentClouds)
+            cloudTransparency.Composite(oitCompositeShader);
+        cloudTimer.End();
+        visibleClouds = cloudBatch.instances;
+        cloudSortMs = cloudBatch.sortMs;
+        cloudPassMs = cloudTimer.LastMs();
 
 
-        // draw skybox
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        // the counts of the opaque pass replace the picture
+        if (overdrawView)
+            overdraw.Draw(overdrawShader);
 
 
         if (programState->ImGuiEnabled)
@@ -560,17 +923,27 @@ int main() {
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    jobs->Wait(simulationDone);
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    delete assetLoader;
+    delete jobs;
+    frameUniforms.Destroy();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVAO);
+    TextureRegistry::Instance().Clear();
+    cloudBatch.Destroy();
+    cloudTransparency.Destroy();
+    cloudImpostors.Destroy();
+    overdraw.Destroy();
+    cloudTimer.Destroy();
+    glDeleteBuffers(1, &transparentVBO);
+    glDeleteVertexArrays(1, &skyVAO);
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -587,11 +960,10 @@ void processInput(GLFWwindow *window) {
         programState->camera.Position = glm::vec3(0.0f, -3.5f, 0.0f);
         programState->CameraMouseMovementUpdateEnabled = true;
         programState->CameraKeyboardMovementUpdateEnabled = true;
-        bird.eaten = false;
-        for (unsigned int i = 0; i < insects.size(); i++) {
-            insects[i].eaten = false;
-        }
-        remainingInsects = insects.size();
+        world.bird.alive = true;
+        insects.Revive();
+        // the frame still shows the eaten bird, the UI would lock the camera again
+        shownFrame->birdAlive = true;
     }
 
     if(programState->CameraMouseMovementUpdateEnabled) {
@@ -668,6 +1040,8 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+
+        ImGui::Text("Assets loading: %u (%u worker threads)", assetLoader->Pending(), assetLoader->ThreadCount());
         ImGui::End();
     }
 
@@ -684,15 +1058,18 @@ void DrawImGui(ProgramState *programState) {
     {
         ImGui::Begin("Game UI");
 
-        if (!bird.eaten) {
+        // the game state is the simulation's, the UI shows the snapshot of the frame
+        const SimulationFrame &simulation = *shownFrame;
+        unsigned int remainingInsects = simulation.remainingInsects;
+        if (simulation.birdAlive) {
             if(remainingInsects > 0) {
                 // Display proximity indicator
-                if (closestInsectDistance < proximityThreshold) {
+                if (simulation.closestInsectDistance < proximityThreshold) {
                     ImGui::Text("Bird is close to an insect!");
                 } else {
                     ImGui::Text("Bird is not close to any insects.");
                 }
-                ImGui::Text("Number of remaining insects: %d", remainingInsects);
+                ImGui::Text("Number of remaining insects: %u", remainingInsects);
             }
 
             // Display message when all insects are eaten
@@ -700,7 +1077,7 @@ void DrawImGui(ProgramState *programState) {
                 ImGui::Text("Congratulations! You have eaten all the insects!");
             }
 
-            if (falconDistance < proximityThreshold) {
+            if (simulation.falconDistance < proximityThreshold) {
                 ImGui::Text("Be careful! The falcon is flying nearby and it's hungry!");
             } else {
                 ImGui::Text("There is no danger for the bird");
@@ -708,7 +1085,7 @@ void DrawImGui(ProgramState *programState) {
         }
 
         // Display message when the bird is eaten
-        if (bird.eaten) {
+        if (!simulation.birdAlive) {
             ImGui::Text("Game over! Your bird was eaten by the falcon!");
             programState->CameraMouseMovementUpdateEnabled = false;
             programState->CameraKeyboardMovementUpdateEnabled = false;
@@ -717,11 +1094,94 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Performance");
+        ImGui::Text("Frame time: %.3f ms (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::Checkbox("Instanced insects", &instancedInsects);
+        static int swarmSize = 1000;
+        ImGui::DragInt("Swarm size", &swarmSize, 100.0f, 0, 1000000);
+        if (ImGui::Button("Spawn swarm"))
+            pendingSwarmSpawn = swarmSize;
+        ImGui::Text("Insects: %u, insect draw calls: %u", shownFrame->remainingInsects, insectDrawCalls);
+        int insectKernel = InsectKernels::Selected();
+        const char *insectKernelNames[InsectKernels::LEVELS];
+        for (int level = 0; level < InsectKernels::LEVELS; level++)
+            insectKernelNames[level] = InsectKernels::Name((InsectKernels::Level)level);
+        if (ImGui::Combo("Insect kernel", &insectKernel, insectKernelNames, InsectKernels::Supported() + 1))
+            InsectKernels::Selected() = (InsectKernels::Level)insectKernel;
+        static float simulationRate = simulationClock.Rate();
+        if (ImGui::SliderFloat("Simulation rate (Hz)", &simulationRate, 10.0f, 480.0f, "%.0f"))
+            simulationClock.SetRate(simulationRate);
+        ImGui::Text("Simulation: %u steps this frame, %.3f ms, insect transforms %.3f ms", shownFrame->steps,
+                    shownFrame->simulationMs, shownFrame->transformsMs);
+        ImGui::Checkbox("Spatial hash queries", &spatialHashQueries);
+        if (spatialHashQueries)
+            ImGui::Text("Spatial hash build %.3f ms, capture and proximity queries %.3f ms", shownFrame->gridBuildMs,
+                        shownFrame->queryMs);
+        int jobThreads = jobs->ActiveThreads();
+        if (ImGui::SliderInt("Job threads", &jobThreads, 1, jobs->ThreadCount()))
+            jobs->SetActiveThreads(jobThreads);
+        // time every thread spent working in jobs during the last frame, the main thread's GL submission isn't a
+        // job. Not clamped, a share over 100% would be a counting error
+        for (unsigned int i = 0; i < jobBusyMs.size(); i++) {
+            const double share = jobFrameMs > 0.0 ? jobBusyMs[i] / jobFrameMs : 0.0;
+            char label[64];
+            snprintf(label, sizeof(label), "%s %u: %.2f ms (%.0f%%)", i == 0 ? "main" : "worker", i, jobBusyMs[i], 100.0 * share);
+            ImGui::ProgressBar((float)share, ImVec2(-1.0f, 0.0f), label);
+        }
+        static int cloudFieldSize = 1000;
+        ImGui::DragInt("Cloud field", &cloudFieldSize, 10.0f, 0, 100000);
+        if (ImGui::Button("Spawn clouds"))
+            SpawnCloudField(cloudFieldSize);
+        ImGui::Checkbox("Order independent clouds", &orderIndependentClouds);
+        ImGui::Checkbox("Cloud impostors", &impostorClouds);
+        ImGui::Text("Clouds: %u visible of %u in 1 draw call, sort %.3f ms, pass %.3f ms GPU", visibleClouds, (unsigned int)clouds.size(),
+                    cloudSortMs, cloudPassMs);
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        ImGui::Text("Objects visible: %u, culled: %u", visibleObjects, culledObjects);
+        ImGui::Checkbox("Sort render queue", &sortRenderQueue);
+        ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+        ImGui::SameLine();
+        ImGui::Checkbox("Front to back", &frontToBack);
+        ImGui::SameLine();
+        ImGui::Checkbox("Overdraw view", &overdrawView);
+        if (skyCubemapAvailable)
+            ImGui::Checkbox("Procedural sky", &proceduralSky);
+        ImGui::Text("Opaque fragments shaded: %.2f M (%.2f per pixel), depth pre-pass draws: %u", renderStats.shadedSamples / 1000000.0,
+                    shadedSamplesPerPixel, renderStats.depthDraws);
+        if (MultiDrawIndirect::Supported())
+            ImGui::Checkbox("Multi-draw indirect", &multiDrawIndirect);
+        else
+            ImGui::Text("Multi-draw indirect: not supported");
+        ImGui::Text("Opaque draws: %u in %u draw calls (%u multi draws), submit %.3f ms", renderStats.issued.draws,
+                    renderStats.drawCalls, renderStats.multiDraws, renderStats.submitMs);
+        ImGui::Text("State changes unsorted: %u (programs %u, VAOs %u, textures %u)", renderStats.naive.StateChanges(),
+                    renderStats.naive.programs, renderStats.naive.vertexArrays, renderStats.naive.textures);
+        ImGui::Text("State changes issued: %u (programs %u, VAOs %u, textures %u)", renderStats.issued.StateChanges(),
+                    renderStats.issued.programs, renderStats.issued.vertexArrays, renderStats.issued.textures);
+        ImGui::Checkbox("Level of detail", &levelOfDetail);
+        ImGui::DragFloat("LOD error (pixels)", &lodErrorPixels, 0.05f, 0.1f, 16.0f);
+        ImGui::Text("Triangles: %u (%u at full detail)", renderStats.triangles, renderStats.trianglesFullDetail);
+        const TextureRegistry::Stats &textureStats = TextureRegistry::Instance().GetStats();
+        ImGui::Text("Textures: %u, requests %u (shared by path %u, by content %u)", textureStats.textures, textureStats.requests,
+                    textureStats.pathHits, textureStats.contentHits);
+        ImGui::Text("Texture VRAM: %.1f MiB (%.1f MiB uncompressed), compression %s", TextureCompression::VramBytes() / 1048576.0,
+                    TextureCompression::UncompressedVramBytes() / 1048576.0, TextureCompression::Enabled() ? "on" : "off");
+        ImGui::End();
+    }
+
     {
         ImGui::Begin("Game positions");
         ImGui::Text("Bird position: (%f, %f, %f)", (programState->modelPosition)[0], (programState->modelPosition)[1], (programState->modelPosition)[2]);
-        ImGui::Text("Closest insect position: (%f, %f, %f), distance: %f", (insects[closestInsectIdx].position)[0], (insects[closestInsectIdx].position)[1], (insects[closestInsectIdx].position)[2], remainingInsects > 0 ? closestInsectDistance : 0);
-        ImGui::Text("Falcon position: (%f, %f, %f), distance: %f", falconPosition[0], falconPosition[1], falconPosition[2], falconDistance);
+        // the spatial hash only looks for insects within the proximity threshold
+        const SimulationFrame &simulation = *shownFrame;
+        if (simulation.closestInsectFound) {
+            const glm::vec3 &closestInsect = simulation.closestInsectPosition;
+            ImGui::Text("Closest insect position: (%f, %f, %f), distance: %f", closestInsect[0], closestInsect[1], closestInsect[2], simulation.closestInsectDistance);
+        } else {
+            ImGui::Text("Closest insect: none within %.1f", proximityThreshold);
+        }
+        ImGui::Text("Falcon position: (%f, %f, %f), distance: %f", simulation.falconPosition[0], simulation.falconPosition[1], simulation.falconPosition[2], simulation.falconDistance);
         ImGui::End();
     }
 
@@ -729,6 +1189,355 @@ void DrawImGui(ProgramState *programState) {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+// starts over with the hand placed insects and scatters count new ones around the area they fly in
+void SpawnInsectSwarm(unsigned int count) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> spreadX(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> spreadY(-10.0f, 2.0f);
+    std::uniform_real_distribution<float> spreadZ(-70.0f, -10.0f);
+
+    insects.Clear();
+    insects.Reserve(handPlacedInsects + count);
+    for (unsigned int i = 0; i < handPlacedInsects; i++) {
+        insects.Add(handPlacedInsectPositions[i], i);
+    }
+    // swarm insects reuse the motion patterns of the hand placed ones
+    for (unsigned int i = 0; i < count; i++) {
+        insects.Add(glm::vec3(spreadX(random), spreadY(random), spreadZ(random)), i % handPlacedInsects);
+    }
+}
+
+void SpawnCloudField(unsigned int count) {
+    std::mt19937 random(4321);
+    std::uniform_real_distribution<float> spreadX(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> spreadY(-3.0f, 1.0f);
+    std::uniform_real_distribution<float> spreadZ(-30.0f, -2.0f);
+
+    clouds.resize(handPlacedClouds);
+    clouds.reserve(handPlacedClouds + count);
+    for (unsigned int i = 0; i < count; i++) {
+        clouds.push_back(glm::vec3(spreadX(random), spreadY(random), spreadZ(random)));
+    }
+}
+
+// called at the start of every frame: sets up each configuration of the cloud benchmark, averages the timings
+// of the frames after its warm up and prints them, and closes the window after the last one
+void StepCloudBenchmark(GLFWwindow *window) {
+    static unsigned int step = 0, frame = 0;
+    static double frameMs = 0.0, passMs = 0.0, sortMs = 0.0;
+    const unsigned int steps = 2 * (sizeof(cloudBenchmarkSizes) / sizeof(cloudBenchmarkSizes[0]));
+
+    if (frame == 0) {
+        unsigned int size = cloudBenchmarkSizes[step / 2];
+        SpawnCloudField(size > handPlacedClouds ? size - handPlacedClouds : 0);
+        orderIndependentClouds = step % 2 == 1;
+    } else if (frame > CLOUD_BENCHMARK_WARMUP) {
+        // deltaTime and the pass timings are those of earlier frames of the same configuration
+        frameMs += deltaTime * 1000.0;
+        passMs += cloudPassMs;
+        sortMs += cloudSortMs;
+    }
+    if (++frame <= CLOUD_BENCHMARK_WARMUP + CLOUD_BENCHMARK_FRAMES)
+        return;
+
+    std::cout << "CLOUD_BENCHMARK:: " << clouds.size() << " clouds, " << (orderIndependentClouds ? "order independent" : "sorted")
+              << ": frame " << frameMs / CLOUD_BENCHMARK_FRAMES << " ms, transparent pass " << passMs / CLOUD_BENCHMARK_FRAMES
+              << " ms GPU, sort " << sortMs / CLOUD_BENCHMARK_FRAMES << " ms CPU" << std::endl;
+    frame = 0;
+    frameMs = passMs = sortMs = 0.0;
+    if (++step == steps)
+        glfwSetWindowShouldClose(window, true);
+}
+
+// called at the start of every frame after the simulation is done: runs the job system with one more thread for
+// every configuration, averages the frames after its warm up and prints them, and closes the window after the last one
+void StepJobBenchmark(GLFWwindow *window) {
+    static unsigned int threads = 1, frame = 0, steps = 0;
+    static double frameMs = 0.0, simulationMs = 0.0, transformsMs = 0.0;
+
+    if (frame == 0) {
+        jobs->SetActiveThreads(threads);
+    } else if (frame > JOB_BENCHMARK_WARMUP) {
+        // deltaTime is the time of the last frame, the snapshot that of the simulation it started
+        frameMs += deltaTime * 1000.0;
+        simulationMs += shownFrame->simulationMs;
+        transformsMs += shownFrame->transformsMs;
+        steps += shownFrame->steps;
+    }
+    if (++frame <= JOB_BENCHMARK_WARMUP + JOB_BENCHMARK_FRAMES)
+        return;
+
+    std::cout << "JOB_BENCHMARK:: " << threads << " of " << jobs->ThreadCount() << " threads, " << insects.AliveCount()
+              << " insects: frame " << frameMs / JOB_BENCHMARK_FRAMES << " ms, simulation "
+              << simulationMs / std::max(steps, 1u) << " ms per step (" << (double)steps / JOB_BENCHMARK_FRAMES
+              << " steps per frame), insect transforms " << transformsMs / JOB_BENCHMARK_FRAMES << " ms" << std::endl;
+    frame = steps = 0;
+    frameMs = simulationMs = transformsMs = 0.0;
+    if (++threads > jobs->ThreadCount())
+        glfwSetWindowShouldClose(window, true);
+}
+
+void RunInsectBenchmark() {
+    // where the bird starts, in the middle of the hand placed insects
+    const glm::vec3 birdPosition = glm::vec3(0.0f, -6.0f, -20.0f);
+    for (unsigned int size : insectBenchmarkSizes) {
+        // final positions of the scalar kernel, the SIMD kernels have to end up at the same places
+        InsectSwarm reference;
+        for (int level = InsectKernels::SCALAR; level <= InsectKernels::Supported(); level++) {
+            SpawnInsectSwarm(size > handPlacedInsects ? size - handPlacedInsects : 0);
+            float time = 100.0f;
+            double stepMs = 0.0;
+            for (unsigned int step = 0; step < INSECT_BENCHMARK_WARMUP + INSECT_BENCHMARK_STEPS; step++) {
+                auto start = std::chrono::steady_clock::now();
+                InsectKernels::Step(insects, time, 1.0f / 60.0f, birdPosition, thresholdDistanceInsects, (InsectKernels::Level)level);
+                if (step >= INSECT_BENCHMARK_WARMUP)
+                    stepMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                time += 1.0f / 60.0f;
+            }
+            stepMs /= INSECT_BENCHMARK_STEPS;
+
+            float deviation = 0.0f;
+            if (level == InsectKernels::SCALAR)
+                reference = insects;
+            else if (reference.AliveCount() != insects.AliveCount())
+                deviation = std::numeric_limits<float>::infinity();
+            else
+                for (unsigned int i = 0; i < insects.Size(); i++)
+                    deviation = std::max(deviation, glm::distance(reference.Position(i), insects.Position(i)));
+            std::cout << "INSECT_BENCHMARK:: " << size << " insects, " << InsectKernels::Name((InsectKernels::Level)level)
+                      << ": " << stepMs << " ms per step, " << insects.AliveCount() / stepMs << " insects/ms, "
+                      << "largest distance from scalar " << deviation << std::endl;
+        }
+    }
+}
+
+// the actors where they are at simulation time 0
+void InitWorld(const glm::vec3 &birdPosition) {
+    world.bird.position = birdPosition;
+    world.falcon.position = glm::vec3(0.0f, 0.0f, -25.0f);
+    world.airBalloon.position = airBalloonOrbitCenter + glm::vec3(36.0f, 0.0f, 10.0f);
+    previousWorld = world;
+}
+
+SimulationSettings CurrentSimulationSettings() {
+    SimulationSettings settings;
+    settings.deltaTime = simulationClock.Step();
+    settings.kernel = InsectKernels::Selected();
+    settings.spatialHash = spatialHashQueries;
+    return settings;
+}
+
+// one fixed step of the game: moves the actors and the insects and checks who eats whom
+void StepSimulation(const SimulationSettings &settings) {
+    previousWorld = world;
+    const float deltaTime = settings.deltaTime;
+    simulationTime += deltaTime;
+    const float time = simulationTime;
+
+    // air balloon, circling around its orbit center
+    world.airBalloon.position = airBalloonOrbitCenter + glm::vec3(cos(0.1f*time)*36.0f, 0.0f, sin(0.1f*time)*36.0f + 10.0f);
+
+    // falcon, easing towards its point on the orbit: a fifth of the way every 1/60 s
+    glm::vec3 falconOrbit = glm::vec3(cos(0.15f*time)*50.0f, -5.0f, sin(0.15f*time)*50.0f);
+    world.falcon.position = glm::mix(world.falcon.position, falconOrbit, 1.0f - std::pow(0.8f, deltaTime * 60.0f));
+    falconDistance = glm::distance(world.bird.position, world.falcon.position);
+
+    // check is the bird eaten by falcon
+    if (falconDistance < thresholdDistanceFalcon) {
+        world.bird.alive = false;
+    }
+
+    // insects: eaten by the bird, moved and the one closest to the bird found in one pass over the store,
+    // or moved and then looked up in the spatial hash
+    InsectStepResult insectStep = settings.spatialHash ? StepInsectsWithGrid(time, deltaTime, world.bird.position, settings.kernel)
+                                                       : StepInsects(time, deltaTime, world.bird.position, thresholdDistanceInsects,
+                                                                     settings.kernel);
+    closestInsectIdx = insectStep.nearest;
+    closestInsectDistance = insectStep.nearestDistance;
+}
+
+InsectStepResult StepInsects(float time, float deltaTime, const glm::vec3 &birdPosition, float captureRadius,
+                             InsectKernels::Level kernel) {
+    // ranges at fixed offsets, so the result is the same whichever thread runs which range
+    static vector<InsectKernels::Partial> partials;
+    const unsigned int count = insects.AliveCount();
+    const unsigned int ranges = std::max((count + INSECT_JOB_GRAIN - 1) / INSECT_JOB_GRAIN, 1u);
+    partials.resize(ranges);
+    for (InsectKernels::Partial &partial : partials) {
+        partial.captured.clear();
+        partial.nearestSquared = std::numeric_limits<float>::max();
+        partial.nearest = -1;
+    }
+    jobs->ParallelFor(0, ranges, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int range = begin; range < end; range++)
+            InsectKernels::StepRange(insects, range * INSECT_JOB_GRAIN, std::min(count, (range + 1) * INSECT_JOB_GRAIN), time,
+                                     deltaTime, birdPosition, captureRadius, kernel, partials[range]);
+    });
+    return InsectKernels::Finish(insects, partials.data(), ranges);
+}
+
+void MoveInsects(float time, float deltaTime, InsectKernels::Level kernel) {
+    jobs->ParallelFor(0, insects.AliveCount(), INSECT_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+        InsectKernels::MoveRange(insects, begin, end, time, deltaTime, kernel);
+    });
+}
+
+void BuildSimulationGraph() {
+    unsigned int simulate = simulationGraph.Add([]() {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int step = 0; step < launchedSimulation.steps; step++)
+            StepSimulation(launchedSimulation);
+        nextFrame->simulationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+    unsigned int insectTransforms = simulationGraph.Add([]() { PublishInsectTransforms(*nextFrame, launchedSimulation); });
+    unsigned int state = simulationGraph.Add([]() { PublishSimulationState(*nextFrame, launchedSimulation); });
+    simulationGraph.Depend(insectTransforms, simulate);
+    simulationGraph.Depend(state, simulate);
+}
+
+// model matrices of the alive insects where the frame sees them, between the last two steps
+void PublishInsectTransforms(SimulationFrame &frame, const SimulationSettings &settings) {
+    auto start = std::chrono::steady_clock::now();
+    const unsigned int count = insects.AliveCount();
+    frame.insectTransforms.resize(count);
+    jobs->ParallelFor(0, count, INSECT_JOB_GRAIN, [&](unsigned int begin, unsigned int end) {
+        insects.Transforms(frame.insectTransforms.data(), begin, end, settings.alpha);
+    });
+    frame.transformsMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// everything else the frame draws and the UI shows
+void PublishSimulationState(SimulationFrame &frame, const SimulationSettings &settings) {
+    frame.airBalloonPosition = glm::mix(previousWorld.airBalloon.position, world.airBalloon.position, settings.alpha);
+    frame.falconPosition = glm::mix(previousWorld.falcon.position, world.falcon.position, settings.alpha);
+    frame.renderTime = simulationTime - (1.0 - settings.alpha) * settings.deltaTime;
+    frame.birdAlive = world.bird.alive;
+    frame.remainingInsects = insects.AliveCount();
+    frame.closestInsectFound = closestInsectIdx >= 0 && (unsigned int)closestInsectIdx < insects.AliveCount();
+    if (frame.closestInsectFound)
+        frame.closestInsectPosition = insects.Position(closestInsectIdx);
+    frame.closestInsectDistance = closestInsectDistance;
+    frame.falconDistance = falconDistance;
+    frame.steps = settings.steps;
+    frame.gridBuildMs = insectGridBuildMs;
+    frame.queryMs = insectQueryMs;
+}
+
+void RunHeadlessSimulation(double seconds) {
+    // the bird stays where it starts, in the middle of the hand placed insects
+    InitWorld(glm::vec3(0.0f, -6.0f, -20.0f));
+    const char *swarm = getenv("LOGL_INSECT_SWARM");
+    SpawnInsectSwarm(swarm ? atoi(swarm) : 0);
+
+    const unsigned int steps = (unsigned int)std::ceil(seconds * simulationClock.Rate());
+    auto start = std::chrono::steady_clock::now();
+    const SimulationSettings settings = CurrentSimulationSettings();
+    for (unsigned int step = 0; step < steps; step++)
+        StepSimulation(settings);
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "HEADLESS_SIM:: " << simulationTime << " s simulated in " << steps << " steps at " << simulationClock.Rate()
+              << " Hz, " << wallMs << " ms (" << simulationTime * 1000.0 / std::max(wallMs, 0.001) << "x real time), "
+              << insects.AliveCount() << " of " << insects.Size() << " insects left, bird "
+              << (world.bird.alive ? "alive" : "eaten") << ", " << jobs->ThreadCount() << " job threads" << std::endl;
+}
+
+InsectStepResult StepInsectsWithGrid(float time, float deltaTime, const glm::vec3 &birdPosition, InsectKernels::Level kernel) {
+    // the kernels only move the insects here, the grid finds the captured and the nearest ones
+    MoveInsects(time, deltaTime, kernel);
+
+    auto buildStart = std::chrono::steady_clock::now();
+    insectGrid.SetCellSize(std::max(thresholdDistanceInsects, proximityThreshold));
+    insectGrid.Build(insects.positionX.data(), insects.positionY.data(), insects.positionZ.data(), insects.AliveCount());
+    auto queryStart = std::chrono::steady_clock::now();
+
+    // insects within the capture radius are eaten, the nearest one is the closest of the others
+    static vector<unsigned int> captured;
+    captured.clear();
+    insectGrid.QueryRadius(birdPosition, thresholdDistanceInsects, captured);
+    InsectStepResult result;
+    result.captured = captured.size();
+    result.nearest = insectGrid.Nearest(birdPosition, thresholdDistanceInsects, proximityThreshold, result.nearestDistance);
+    // highest index first, so every swap brings in an insect that stays
+    std::sort(captured.begin(), captured.end(), std::greater<unsigned int>());
+    for (unsigned int i : captured) {
+        unsigned int moved = insects.Remove(i);
+        if (result.nearest == (int)moved)
+            result.nearest = i;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    insectGridBuildMs = std::chrono::duration<double, std::milli>(queryStart - buildStart).count();
+    insectQueryMs = std::chrono::duration<double, std::milli>(end - queryStart).count();
+    return result;
+}
+
+int RunSpatialHashBenchmark() {
+    std::mt19937 random(5678);
+    std::uniform_real_distribution<float> queryX(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> queryY(-10.0f, 2.0f);
+    std::uniform_real_distribution<float> queryZ(-70.0f, -10.0f);
+    unsigned int mismatches = 0;
+    for (unsigned int size : spatialHashBenchmarkSizes) {
+        SpawnInsectSwarm(size > handPlacedInsects ? size - handPlacedInsects : 0);
+        const unsigned int count = insects.AliveCount();
+        const float *x = insects.positionX.data(), *y = insects.positionY.data(), *z = insects.positionZ.data();
+
+        // timed on the second build, like the per-frame builds it reuses the memory of the first
+        insectGrid.SetCellSize(std::max(thresholdDistanceInsects, proximityThreshold));
+        insectGrid.Build(x, y, z, count);
+        auto buildStart = std::chrono::steady_clock::now();
+        insectGrid.Build(x, y, z, count);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+        double gridMs = 0.0, bruteMs = 0.0;
+        unsigned long long found = 0;
+        vector<unsigned int> gridResult, bruteResult;
+        for (unsigned int query = 0; query < SPATIAL_HASH_BENCHMARK_QUERIES; query++) {
+            glm::vec3 point(queryX(random), queryY(random), queryZ(random));
+
+            auto gridStart = std::chrono::steady_clock::now();
+            gridResult.clear();
+            insectGrid.QueryRadius(point, thresholdDistanceInsects, gridResult);
+            float gridDistance;
+            int gridNearest = insectGrid.Nearest(point, thresholdDistanceInsects, proximityThreshold, gridDistance);
+            auto bruteStart = std::chrono::steady_clock::now();
+
+            // the same two queries as linear scans
+            bruteResult.clear();
+            const float captureSquared = thresholdDistanceInsects * thresholdDistanceInsects;
+            float bruteSquared = proximityThreshold * proximityThreshold;
+            int bruteNearest = -1;
+            for (unsigned int i = 0; i < count; i++) {
+                float dx = x[i] - point.x, dy = y[i] - point.y, dz = z[i] - point.z;
+                float squared = dx * dx + dy * dy + dz * dz;
+                if (squared < captureSquared) {
+                    bruteResult.push_back(i);
+                } else if (squared < bruteSquared) {
+                    bruteSquared = squared;
+                    bruteNearest = i;
+                }
+            }
+            auto bruteEnd = std::chrono::steady_clock::now();
+            gridMs += std::chrono::duration<double, std::milli>(bruteStart - gridStart).count();
+            bruteMs += std::chrono::duration<double, std::milli>(bruteEnd - bruteStart).count();
+
+            std::sort(gridResult.begin(), gridResult.end());
+            if (gridResult != bruteResult || gridNearest != bruteNearest)
+                mismatches++;
+            found += gridResult.size();
+        }
+        std::cout << "SPATIAL_HASH_BENCHMARK:: " << count << " insects: build " << buildMs << " ms, per query "
+                  << 1000.0 * gridMs / SPATIAL_HASH_BENCHMARK_QUERIES << " us with the hash, "
+                  << 1000.0 * bruteMs / SPATIAL_HASH_BENCHMARK_QUERIES << " us brute force, "
+                  << (double)found / SPATIAL_HASH_BENCHMARK_QUERIES << " captures per query" << std::endl;
+    }
+    if (mismatches > 0)
+        std::cout << "ERROR::SPATIAL_HASH_BENCHMARK:: " << mismatches << " queries differ from brute force" << std::endl;
+    else
+        std::cout << "SPATIAL_HASH_BENCHMARK:: all queries match brute force" << std::endl;
+    return mismatches > 0 ? 1 : 0;
+}
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
@@ -746,81 +1555,3 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         std::cout << "Camera lock - " << (programState->CameraMouseMovementUpdateEnabled ? "Disabled" : "Enabled") << '\n';
     }
 }
-
-// loads a cubemap texture from 6 individual texture faces
-// order:
-// +X (right)
-// -X (left)
-// +Y (top)
-// -Y (bottom)
-// +Z (front)
-// -Z (back)
-// -------------------------------------------------------
-unsigned int loadCubemap(vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
-
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const * path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); //NEAREST?
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //NEAREST?
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
\ No newline at end of file